@@ -52,6 +52,16 @@ namespace APLoader {
                 return "waiting for EEPROM programming status";
             case Status::WaitingForEEPROMVerificationStatus:
                 return "waiting for EEPROM verification status";
+            case Status::SendingCommitRequest:
+                return "sending commit request";
+            case Status::WaitingForRAMVerificationStatus:
+                return "waiting for RAM verification status";
+            case Status::EstablishingHelperCommunications:
+                return "establishing helper communications";
+            case Status::StreamingPayload:
+                return "streaming payload";
+            case Status::BootingKernel:
+                return "booting kernel";
             default:
                 return "unknown";
         }
@@ -62,7 +72,7 @@ namespace APLoader {
 
     bool actionIsValid(Action action) {
         // Necessary, since this test considers None invalid.
-        return action == Action::Shutdown || action == Action::LoadRAM || action == Action::ProgramEEPROMThenShutdown || action == Action::ProgramEEPROMThenRun || action == Action::Restart;
+        return action == Action::Shutdown || action == Action::LoadRAM || action == Action::ProgramEEPROMThenShutdown || action == Action::ProgramEEPROMThenRun || action == Action::Restart || action == Action::CommitRAMToEEPROM || action == Action::LoadXMM || action == Action::ProvisionSD;
     }
 
     std::string strForAction(Action action) {
@@ -77,6 +87,12 @@ namespace APLoader {
                 return "program EEPROM then run";
             case Action::Restart:
                 return "restart";
+            case Action::CommitRAMToEEPROM:
+                return "commit RAM to EEPROM";
+            case Action::LoadXMM:
+                return "load XMM";
+            case Action::ProvisionSD:
+                return "provision SD";
             case Action::None:
                 return "none";
             default:
@@ -85,7 +101,11 @@ namespace APLoader {
     }
 
     bool actionRequiresImage(Action action) {
-        return action == Action::LoadRAM || action == Action::ProgramEEPROMThenShutdown || action == Action::ProgramEEPROMThenRun;
+        return action == Action::LoadRAM || action == Action::ProgramEEPROMThenShutdown || action == Action::ProgramEEPROMThenRun || action == Action::CommitRAMToEEPROM || action == Action::LoadXMM || action == Action::ProvisionSD;
+    }
+
+    bool actionUsesHelper(Action action) {
+        return action == Action::LoadXMM || action == Action::ProvisionSD;
     }
 
     uint32_t commandForAction(Action action) {
@@ -93,6 +113,8 @@ namespace APLoader {
             case Action::Shutdown:
                 return 0;
             case Action::LoadRAM:
+            case Action::LoadXMM:
+            case Action::ProvisionSD:
                 return 1;
             case Action::ProgramEEPROMThenShutdown:
                 return 2;
@@ -168,6 +190,30 @@ namespace APLoader {
                 return "failed to receive EEPROM verification status";
             case ErrorCode::PropReportsEEPROMVerificationError:
                 return "Propeller reports EEPROM verification error";
+            case ErrorCode::FailedToReceiveRAMVerificationStatus:
+                return "failed to receive RAM verification status";
+            case ErrorCode::PropReportsRAMVerificationError:
+                return "Propeller reports RAM verification error";
+            case ErrorCode::FailedToEstablishHelperComms:
+                return "failed to establish helper communications";
+            case ErrorCode::FailedToSendPayloadBlock:
+                return "failed to send payload block";
+            case ErrorCode::FailedToReceivePayloadBlockStatus:
+                return "failed to receive payload block status";
+            case ErrorCode::HelperReportsPayloadBlockError:
+                return "helper reports payload block error";
+            case ErrorCode::FailedToSendKernel:
+                return "failed to send kernel";
+            case ErrorCode::FailedToReceiveKernelStatus:
+                return "failed to receive kernel status";
+            case ErrorCode::HelperReportsKernelError:
+                return "helper reports kernel error";
+            case ErrorCode::FailedToSendFileFrame:
+                return "failed to send file frame";
+            case ErrorCode::FailedToReceiveFileStatus:
+                return "failed to receive file status";
+            case ErrorCode::HelperReportsFileError:
+                return "helper reports file error";
             case ErrorCode::UnhandledException:
                 return "BUG: unhandled exception";
             default:
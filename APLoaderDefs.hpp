@@ -13,6 +13,7 @@
 #include <cstddef>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "SimpleChrono.hpp"
 
@@ -76,6 +77,8 @@ namespace APLoader {
      \brief These identify the status of the loader when performing an action.
      
      These status values are reported to user via the StatusMonitor::loaderUpdate() callback.
+
+     StreamingPayload is reported once when streaming begins, and again after each payload block.
      
      \see strForStatus, StatusMonitor::loaderUpdate
      */
@@ -85,7 +88,12 @@ namespace APLoader {
         SendingCommandAndImage,
         WaitingForChecksumStatus,
         WaitingForEEPROMProgrammingStatus,
-        WaitingForEEPROMVerificationStatus
+        WaitingForEEPROMVerificationStatus,
+        SendingCommitRequest,
+        WaitingForRAMVerificationStatus,
+        EstablishingHelperCommunications,
+        StreamingPayload,
+        BootingKernel
     };
 
     /*!
@@ -108,7 +116,13 @@ namespace APLoader {
      Restart just means to toggle the reset line without interacting with the booter program. In
      this case the Propeller should eventually attempt to run from the EEPROM.
 
-     \see actionIsValid, actionRequiresImage, strForAction, commandForAction,
+     CommitRAMToEEPROM does not reset the Propeller or interact with the booter program. Instead,
+     it asks a hook in the already running firmware to program the EEPROM from hub RAM.
+
+     LoadXMM and ProvisionSD use the booter to load a helper image into RAM, and then stream a
+     payload to the helper at a higher baudrate.
+
+     \see actionIsValid, actionRequiresImage, actionUsesHelper, strForAction, commandForAction,
      ActionSummary::action
      */
     enum class Action {
@@ -117,7 +131,10 @@ namespace APLoader {
         LoadRAM,
         ProgramEEPROMThenShutdown,
         ProgramEEPROMThenRun,
-        Restart
+        Restart,
+        CommitRAMToEEPROM,
+        LoadXMM,
+        ProvisionSD
     };
 
     /*!
@@ -135,6 +152,13 @@ namespace APLoader {
      */
     bool actionRequiresImage(Action action);
 
+    /*!
+     \brief Indicates if the action loads a helper image and then streams a payload to it.
+
+     For these actions the image is the helper image.
+     */
+    bool actionUsesHelper(Action action);
+
     /*!
      \brief Returns the command number for a given action.
      
@@ -187,6 +211,18 @@ namespace APLoader {
         PropReportsEEPROMProgrammingError,
         FailedToReceiveEEPROMVerificationStatus,
         PropReportsEEPROMVerificationError,
+        FailedToReceiveRAMVerificationStatus,
+        PropReportsRAMVerificationError,        // Hub RAM no longer matches the image (commit only).
+        FailedToEstablishHelperComms,           // The helper did not answer at the helper baudrate.
+        FailedToSendPayloadBlock,
+        FailedToReceivePayloadBlockStatus,
+        HelperReportsPayloadBlockError,         // The helper failed to write or verify a block.
+        FailedToSendKernel,
+        FailedToReceiveKernelStatus,
+        HelperReportsKernelError,
+        FailedToSendFileFrame,                  // An open or close frame could not be sent.
+        FailedToReceiveFileStatus,
+        HelperReportsFileError,                 // The helper failed to open or close an SD file.
         UnhandledException                      // A bug AsyncPropLoader.
     };
 
@@ -236,6 +272,15 @@ namespace APLoader {
          */
         uint32_t baudrate;
 
+        /*!
+         \brief The baudrate the serial adapter is expected to actually produce, in bps.
+
+         This is the rate used for all timing calculations. It may differ slightly from the
+         requested baudrate due to the adapter's divisor resolution.
+         \see AsyncPropLoader::setAdapterBaseClock
+         */
+        double achievedBaudrate;
+
         /*!
          \brief The reset duration used when performing the action, in milliseconds.
          \see AsyncPropLoader::setResetDuration
@@ -260,6 +305,52 @@ namespace APLoader {
          */
         size_t encodedImageSize;
 
+        /*!
+         \brief The baudrate used to communicate with the helper (helper actions only).
+         \see AsyncPropLoader::setHelperBaudrate
+         */
+        uint32_t helperBaudrate;
+
+        /*!
+         \brief The helper baudrate the serial adapter is expected to actually produce.
+         \see achievedBaudrate
+         */
+        double achievedHelperBaudrate;
+
+        /*!
+         \brief The size of the payload streamed to the helper, in bytes.
+         */
+        size_t payloadSize;
+
+        /*!
+         \brief The number of blocks in the payload.
+         */
+        size_t payloadBlocks;
+
+        /*!
+         \brief The number of payload blocks that were sent and written.
+         */
+        size_t payloadBlocksWritten;
+
+        /*!
+         \brief The number of payload blocks that were skipped because the helper reported that
+         the destination already held the same data.
+         */
+        size_t payloadBlocksSkipped;
+
+        /*!
+         \brief The size of the kernel image sent to the helper to boot, in bytes.
+         */
+        size_t kernelSize;
+
+        /*!
+         \brief The payload size divided by the time taken to stream it (stage 9), in bytes per
+         second.
+
+         Skipped blocks are included, so this is the effective rate rather than the line rate.
+         */
+        float payloadThroughput;
+
         /// \} /Basic Information
 
         /*!
@@ -300,6 +391,9 @@ namespace APLoader {
 
         float stage6Time;   // Stage 6: Wait for EEPROM Programming Status
         float stage7Time;   // Stage 7: Wait for EEPROM Verification Status
+        float stage8Time;   // Stage 8: Establish Helper Communications
+        float stage9Time;   // Stage 9: Stream Payload
+        float stage10Time;  // Stage 10: Boot Kernel
         float encodingTime; // Image encoding is part of Stage 1.
 
         /// \} /Timings
@@ -310,10 +404,19 @@ namespace APLoader {
             wasSuccessful = false;
             errorCode = ErrorCode::None;
             baudrate = 0;
+            achievedBaudrate = 0.0;
             resetDuration = 0;
             bootWaitDuration = 0;
             imageSize = 0;
             encodedImageSize = 0;
+            helperBaudrate = 0;
+            achievedHelperBaudrate = 0.0;
+            payloadSize = 0;
+            payloadBlocks = 0;
+            payloadBlocksWritten = 0;
+            payloadBlocksSkipped = 0;
+            kernelSize = 0;
+            payloadThroughput = 0.0f;
 
             totalTime = 0.0f;
 
@@ -328,12 +431,38 @@ namespace APLoader {
             stage5Time = 0.0f;
             stage6Time = 0.0f;
             stage7Time = 0.0f;
+            stage8Time = 0.0f;
+            stage9Time = 0.0f;
+            stage10Time = 0.0f;
 
             encodingTime = 0.0f;
         }
     };
 
 
+#pragma mark - SDFile Struct
+
+    /*!
+     \brief A file to be written to a Propeller board's SD card.
+     \see AsyncPropLoader::provisionSD
+     */
+    struct SDFile {
+
+        /*!
+         \brief The path of the file on the card (e.g. "AUDIO/BEEP.WAV").
+
+         The supported path syntax (8.3 or long names, directory separators) depends on the
+         helper's FAT implementation.
+         */
+        std::string path;
+
+        /*!
+         \brief The contents of the file.
+         */
+        std::vector<uint8_t> data;
+    };
+
+
 #pragma mark - StatusMonitor
 
     class AsyncPropLoader;
@@ -369,6 +498,9 @@ namespace APLoader {
          estimatedTotalSeconds may change between calls. It will always be greater than
          secondsTakenSoFar.
 
+         While a payload is streamed to a helper this callback is also called after each
+         block (with Status::StreamingPayload) so that progress can be followed.
+
          This callback should return quickly. While it is executing the loader is idle. If the
          loader is idle for too long (approximately 100 milliseconds) the Propeller will reboot.
          Consider redispatching to work to another thread.
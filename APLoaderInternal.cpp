@@ -8,6 +8,7 @@
 
 #include "APLoaderInternal.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <sstream>
@@ -50,7 +51,7 @@ namespace APLoader {
         return decodedByte;
     }
 
-    size_t verifyAndEncodeImage(const std::vector<uint8_t>& image, std::vector<uint8_t>& encodedImage) {
+    void verifyImage(const std::vector<uint8_t>& image) {
 
         // todo: revise
         if (image.size() == 0) {
@@ -65,24 +66,170 @@ namespace APLoader {
 
         // todo: verify checksum
         // Remember to account for automatic stack bottom.
+    }
+
+    size_t verifyAndEncodeImage(const std::vector<uint8_t>& image, std::vector<uint8_t>& encodedImage) {
+
+        verifyImage(image);
 
         ThreeBitProtocolEncoder encoder(encodedImage);
         return encoder.encodeBytesAsLongs(image);
     }
 
+    double achievedBaudrate(uint32_t baudrate, uint32_t baseClock) {
+        if (baseClock == 0 || baudrate == 0) {
+            return baudrate;
+        }
+        // The divisor in eighths, rounded to nearest. Divisors below 1 are not possible.
+        uint64_t eighths = (8ull * baseClock + baudrate / 2) / baudrate;
+        if (eighths < 8) eighths = 8;
+        return 8.0 * baseClock / eighths;
+    }
+
+    /*!
+     \brief Creates the lookup table used by crc32.
+     */
+    static std::vector<uint32_t> makeCRC32Table() {
+        std::vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+        static const std::vector<uint32_t> table = makeCRC32Table();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+
+#pragma mark - Commit Protocol
+
+    /*!
+     \brief Appends a little-endian long to the buffer.
+     */
+    static void appendLong(std::vector<uint8_t>& buffer, uint32_t value) {
+        buffer.push_back(value & 0xff);
+        buffer.push_back((value >> 8) & 0xff);
+        buffer.push_back((value >> 16) & 0xff);
+        buffer.push_back((value >> 24) & 0xff);
+    }
+
+    uint32_t composeEEPROMImage(const std::vector<uint8_t>& image, std::vector<uint8_t>& eepromImage) {
+
+        verifyImage(image);
+
+        if (image.size() < 16) {
+            throw std::invalid_argument("Image is too small to contain a header.");
+        }
+
+        // vbase (the end of the program) and dbase are the words at offsets 8 and 10 of the
+        //  header. The stack markers go just below dbase.
+        uint32_t vbase = image[8] | (image[9] << 8);
+        uint32_t dbase = image[10] | (image[11] << 8);
+        size_t paddedSize = (image.size() + 3) & ~static_cast<size_t>(3);
+        if (vbase < 16 || vbase % 4 != 0 || vbase > paddedSize) {
+            std::stringstream ss;
+            ss << "Image header has an invalid vbase (" << vbase << ").";
+            throw std::invalid_argument(ss.str());
+        }
+        if (dbase % 4 != 0 || dbase < vbase + 8 || dbase > 32768) {
+            std::stringstream ss;
+            ss << "Image header has an invalid dbase (" << dbase << ").";
+            throw std::invalid_argument(ss.str());
+        }
+        uint32_t markerAddress = dbase - 8;
+
+        // Only the program (up to vbase) is kept. Anything after it is the VAR and stack
+        //  space of an .eeprom style image, which must be what the booter would put there.
+        eepromImage.assign(32768, 0);
+        std::copy(image.begin(), image.begin() + std::min<size_t>(vbase, image.size()), eepromImage.begin());
+
+        for (uint32_t i = markerAddress; i < dbase; i += 4) {
+            eepromImage[i] = 0xff;
+            eepromImage[i + 1] = 0xff;
+            eepromImage[i + 2] = 0xf9;
+            eepromImage[i + 3] = 0xff;
+        }
+
+        if (!std::equal(image.begin() + std::min<size_t>(vbase, image.size()), image.end(), eepromImage.begin() + vbase)) {
+            throw std::invalid_argument("Image has data after vbase other than the stack markers.");
+        }
+
+        return markerAddress;
+    }
+
+    void composeCommitRequest(const std::vector<uint8_t>& image, std::vector<uint8_t>& request) {
+
+        std::vector<uint8_t> eepromImage;
+        uint32_t markerAddress = composeEEPROMImage(image, eepromImage);
+
+        // Only the program, up to vbase, is checked. The VAR and stack space after it change as
+        //  soon as the image runs. vbase was validated by composeEEPROMImage.
+        uint32_t imageSize = eepromImage[8] | (eepromImage[9] << 8);
+
+        request = CommitRequestMagic;
+        appendLong(request, imageSize);
+        appendLong(request, crc32(eepromImage.data(), imageSize));
+        appendLong(request, markerAddress);
+        appendLong(request, crc32(eepromImage.data(), eepromImage.size()));
+    }
+
+
+#pragma mark - Helper Protocol
+
+    void composeHelperFrameHeader(uint8_t type, uint32_t address, uint32_t length, uint32_t dataCRC, std::vector<uint8_t>& frame) {
+        frame.clear();
+        frame.push_back(type);
+        appendLong(frame, address);
+        appendLong(frame, length);
+        appendLong(frame, dataCRC);
+        appendLong(frame, crc32(frame.data(), frame.size()));
+        assert(frame.size() == HelperFrameHeaderSize);
+    }
+
 
 #pragma mark - Profiler
     
-    void AsyncPropLoader::Profiler::start(APLoader::Action action, uint32_t baudrate, const Milliseconds& resetDuration, const Milliseconds& bootWaitDuration) {
+    void AsyncPropLoader::Profiler::start(APLoader::Action action, uint32_t baudrate, double achievedBaudrate, const Milliseconds& resetDuration, const Milliseconds& bootWaitDuration) {
         currStage = Stage::Stage1;
         startTiming();
         summary.reset();
         summary.action = action;
         summary.baudrate = baudrate;
+        summary.achievedBaudrate = achievedBaudrate;
         summary.resetDuration = resetDuration.count();
         summary.bootWaitDuration = bootWaitDuration.count();
     }
 
+    void AsyncPropLoader::Profiler::setHelperBaudrate(uint32_t helperBaudrate, double achievedHelperBaudrate) {
+        summary.helperBaudrate = helperBaudrate;
+        summary.achievedHelperBaudrate = achievedHelperBaudrate;
+    }
+
+    void AsyncPropLoader::Profiler::willStreamPayload(size_t payloadSize, size_t numBlocks, size_t kernelSize) {
+        summary.payloadSize = payloadSize;
+        summary.payloadBlocks = numBlocks;
+        summary.kernelSize = kernelSize;
+    }
+
+    void AsyncPropLoader::Profiler::finishedPayloadBlock(bool wasSkipped) {
+        assert(currStage == Stage::Stage9);
+        if (wasSkipped) {
+            summary.payloadBlocksSkipped += 1;
+        } else {
+            summary.payloadBlocksWritten += 1;
+        }
+    }
+
     void AsyncPropLoader::Profiler::willStartEncodingImage(size_t imageSize) {
         summary.imageSize = imageSize;
         encodingStart = SteadyClock::now();
@@ -95,30 +242,51 @@ namespace APLoader {
     }
 
     float AsyncPropLoader::Profiler::getEstimatedTotalTime() {
-        float secondsPerByte = 10.0f / summary.baudrate;
-        float estimate = summary.totalTime;
+        float secondsPerByte = static_cast<float>(10.0 / summary.achievedBaudrate);
+        float estimate = getElapsedTime();
+        // The commit action skips stages 2 and 3 (there is no reset or booter handshake).
+        bool usesBooter = summary.action != Action::CommitRAMToEEPROM;
+        // Helper actions skip stages 6 and 7, and go on to stages 8 to 10.
+        bool usesHelper = actionUsesHelper(summary.action);
         switch (currStage) {
             case Stage::Stage1:     // Stage 1: Preparation
                 estimate += 0.1f;   //  using 0.1f just to guarantee estimate is non-zero
             case Stage::Stage2a:    // Stage 2a: Reset
-                estimate += summary.resetDuration / 1000.0f;
+                if (usesBooter) estimate += summary.resetDuration / 1000.0f;
                 if (summary.action == Action::Restart) break;
             case Stage::Stage2b:    // Stage 2b: Wait After Reset
-                estimate += summary.bootWaitDuration / 1000.0f;
+                if (usesBooter) estimate += summary.bootWaitDuration / 1000.0f;
             case Stage::Stage3:     // Stage 3: Establish Comms
-                estimate +=  InitBytes.size() * secondsPerByte;
+                if (usesBooter) estimate +=  InitBytes.size() * secondsPerByte;
             case Stage::Stage4a:    // Stage 4a: Send Command
                 // The actual time for this stage is insignificant (just sending 4 bytes).
                 if (summary.action == Action::Shutdown) break;
-            case Stage::Stage4b:    // Stage 4b: Send Image
+            case Stage::Stage4b:    // Stage 4b: Send Image (the commit action has no image to send)
                 estimate += summary.encodedImageSize * secondsPerByte;
-            case Stage::Stage5:     // Stage 5: Wait for Checksum Status
+            case Stage::Stage5:     // Stage 5: Wait for Checksum (or RAM Verification) Status
                 estimate += 0.1f;   //  approx 0.1 seconds at 12 MHz
                 if (summary.action == Action::LoadRAM) break;
             case Stage::Stage6:     // Stage 6: Wait for EEPROM Programming Status
-                estimate += 3.7f;   //  approx 3.7 seconds at 12 MHz
+                if (!usesHelper) estimate += 3.7f;   //  approx 3.7 seconds at 12 MHz
             case Stage::Stage7:     // Stage 7: Wait for EEPROM Verification Status
-                estimate += 1.3f;   //  approx 1.3 seconds at 12 MHz
+                if (!usesHelper) estimate += 1.3f;   //  approx 1.3 seconds at 12 MHz
+                if (!usesHelper) break;
+            case Stage::Stage8:     // Stage 8: Establish Helper Communications
+                estimate += 0.1f;   //  the helper needs a moment to start
+            case Stage::Stage9: {   // Stage 9: Stream Payload
+                // Assumes the remaining blocks will be written (not skipped), with about 50 ms
+                //  per block for erasing and programming SPI flash. SD writes are pipelined, so
+                //  their time is mostly hidden by the transmission time.
+                float helperSecondsPerByte = static_cast<float>(10.0 / summary.achievedHelperBaudrate);
+                float blockWriteTime = (summary.action == Action::LoadXMM) ? 0.05f : 0.0f;
+                size_t blocksDone = summary.payloadBlocksWritten + summary.payloadBlocksSkipped;
+                size_t blocksRemaining = (summary.payloadBlocks > blocksDone) ? (summary.payloadBlocks - blocksDone) : 0;
+                estimate += blocksRemaining * (HelperBlockSize * helperSecondsPerByte + blockWriteTime);
+            }
+            case Stage::Stage10:    // Stage 10: Boot Kernel
+                if (summary.kernelSize > 0) {
+                    estimate += summary.kernelSize * static_cast<float>(10.0 / summary.achievedHelperBaudrate);
+                }
             case Stage::Finished:
                 estimate += 0.0f;
         }
@@ -187,10 +355,40 @@ namespace APLoader {
 
     void AsyncPropLoader::Profiler::endStage7() {
         assert(currStage == Stage::Stage7);
+        incrementStage(currStage);
         summary.stage7Time = stageTime();
         summary.totalTime += summary.stage7Time;
     }
 
+    void AsyncPropLoader::Profiler::endStage8() {
+        assert(currStage == Stage::Stage8);
+        incrementStage(currStage);
+        summary.stage8Time = stageTime();
+        summary.totalTime += summary.stage8Time;
+    }
+
+    void AsyncPropLoader::Profiler::endStage9() {
+        assert(currStage == Stage::Stage9);
+        incrementStage(currStage);
+        summary.stage9Time = stageTime();
+        summary.totalTime += summary.stage9Time;
+        bool allBlocksDone = summary.payloadBlocksWritten + summary.payloadBlocksSkipped == summary.payloadBlocks;
+        if (allBlocksDone && summary.stage9Time > 0.0f) {
+            summary.payloadThroughput = summary.payloadSize / summary.stage9Time;
+        }
+    }
+
+    void AsyncPropLoader::Profiler::endStage10() {
+        assert(currStage == Stage::Stage10);
+        summary.stage10Time = stageTime();
+        summary.totalTime += summary.stage10Time;
+    }
+
+    void AsyncPropLoader::Profiler::skipStage() {
+        // The time since the last stage ended is left to the next stage.
+        incrementStage(currStage);
+    }
+
     void AsyncPropLoader::Profiler::endOK() {
         currStage = Stage::Finished;
         summary.wasSuccessful = true;
@@ -225,6 +423,15 @@ namespace APLoader {
             case Stage::Stage7:
                 endStage7();
                 break;
+            case Stage::Stage8:
+                endStage8();
+                break;
+            case Stage::Stage9:
+                endStage9();
+                break;
+            case Stage::Stage10:
+                endStage10();
+                break;
             default:
                 assert(false);
         }
@@ -237,10 +444,10 @@ namespace APLoader {
         if (stage < Stage::Stage1) {
             // Stage is invalid.
             assert(false);
-        } else if (stage < AsyncPropLoader::Profiler::Stage::Stage7) {
+        } else if (stage < AsyncPropLoader::Profiler::Stage::Stage10) {
             stage = static_cast<Stage>( static_cast<int>(stage) + 1 );
         } else {
-            // Can't go past stage 7.
+            // Can't go past stage 10.
             assert(false);
         }
     }
@@ -249,6 +456,14 @@ namespace APLoader {
         stageStart = SteadyClock::now();
     }
 
+    float AsyncPropLoader::Profiler::getElapsedTime() {
+        if (currStage == Stage::Finished) {
+            return summary.totalTime;
+        }
+        SteadyTimePoint now = SteadyClock::now();
+        return summary.totalTime + (duration_cast<duration<float>>(now - stageStart)).count();
+    }
+
     float AsyncPropLoader::Profiler::stageTime() {
         SteadyTimePoint now = SteadyClock::now();
         float time = (duration_cast<duration<float>>(now - stageStart)).count();
@@ -32,17 +32,23 @@ namespace APLoader {
      transmission prompts (0xAD) to receive 250 Propeller authentication bits, and the transmission
      prompts to receive the 8 version bits.
 
+     The host authentication bits are separated by two bit periods of high idle, since the
+     booter needs 60 clocks between them. (They were encoded with ThreeBitProtocolEncoder's
+     packing rules, using two bit periods of idle after every bit.)
+
      This prepared data must not be transmitted at baudrates
-     faster than 115200 bps.
+     faster than ThreeBitProtocolEncoder::MaxBaudrate (133333 bps).
 
      \see PropAuthBytes, decode3BPByte, ThreeBitProtocolEncoder::MaxBaudrate
      */
     const std::vector<uint8_t> InitBytes =
-    {0xf9,0x4a,0x25,0xd5,0x4a,0xd5,0x92,0x95,0x4a,0x92,0xd5,0x92,0xca,0xca,0x4a,
-        0x95,0xca,0xd2,0x92,0xa5,0xa9,0xc9,0x4a,0x49,0x49,0x2a,0x25,0x49,0xa5,0x4a,
-        0xaa,0x2a,0xa9,0xca,0xaa,0x55,0x52,0xaa,0xa9,0x29,0x92,0x92,0x29,0x25,0x2a,
-        0xaa,0x92,0x92,0x55,0xca,0x4a,0xca,0xca,0x92,0xca,0x92,0x95,0x55,0xa9,0x92,
-        0x2a,0xd2,0x52,0x92,0x52,0xca,0xd2,0xca,0x2a,0xff,0xad,0xad,0xad,0xad,0xad,
+    {0xf9,0xf6,0xb6,0xf3,0xb6,0x9b,0xb3,0xdb,0xf3,0xe6,0xdb,0xe6,0xb3,0xe6,0xb6,
+        0x9b,0xe6,0xf6,0xe6,0xf3,0xf6,0xb6,0x9b,0xf6,0xe6,0xf6,0xe6,0xb6,0xb6,0xb6,
+        0xf3,0xe6,0xb3,0xf3,0xb6,0xe6,0xb3,0xb3,0xf3,0xf6,0xe6,0xdb,0xf6,0xf6,0xf6,
+        0xb6,0xb3,0xb3,0xb6,0xf6,0xe6,0xdb,0xdb,0x9b,0xb6,0xb6,0x9b,0xdb,0xf6,0xe6,
+        0xe6,0xe6,0xf6,0xf6,0xb6,0xe6,0xb6,0xe6,0xdb,0xe6,0xe6,0xe6,0xdb,0x9b,0xf3,
+        0xf6,0xf6,0xf6,0xe6,0xf3,0xe6,0xe6,0xf3,0xe6,0xb6,0xb3,0xdb,0x9b,0x9b,0xe6,
+        0xb6,0xe6,0xf6,0xe6,0x9b,0xe6,0xe6,0x9b,0xf3,0xe6,0xb3,0xe6,0x9b,0xff,0xad,
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
@@ -51,7 +57,7 @@ namespace APLoader {
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
         0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad,
-        0xad,0xad,0xad,0xad};
+        0xad,0xad,0xad,0xad,0xad,0xad,0xad,0xad};
 
     /*!
      \brief Prepared data for authenticating the Propeller chip.
@@ -107,6 +113,14 @@ namespace APLoader {
      */
     uint8_t decode3BPByte(std::vector<uint8_t>::iterator& iter, const std::vector<uint8_t>::iterator end);
 
+    /*!
+     \brief Verifies that image is valid.
+
+     \throws std::invalid_argument Thrown if the image is too small, too big, or has an invalid
+     checksum.
+     */
+    void verifyImage(const std::vector<uint8_t>& image);
+
     /*!
      \brief Verifies that image is valid, and encodes it in 3BP format into encodedImage.
 
@@ -114,13 +128,251 @@ namespace APLoader {
 
      \throws std::invalid_argument Thrown if the image is too small, too big, or has an invalid
      checksum.
-     \see ThreeBitProtocolEncoder::encodeBytesAsLongs
+     \see verifyImage, ThreeBitProtocolEncoder::encodeBytesAsLongs
      */
     size_t verifyAndEncodeImage(const std::vector<uint8_t>& image, std::vector<uint8_t>& encodedImage);
+
+    /*!
+     \brief Returns the baudrate a serial adapter is expected to actually produce when the given
+     baudrate is requested.
+
+     The model is that of the FTDI chips (e.g. the FT232R and FT231X used on the Prop Plug):
+     the adapter divides baseClock by a divisor with a resolution of 1/8, and the driver picks
+     the divisor nearest to the requested rate.
+
+     If baseClock is 0 the adapter is assumed to produce the requested baudrate exactly.
+
+     \see AsyncPropLoader::setAdapterBaseClock
+     */
+    double achievedBaudrate(uint32_t baudrate, uint32_t baseClock);
+
+    /*!
+     \brief Computes the CRC-32 (IEEE 802.3, as used by zlib) of the given data.
+
+     A running CRC may be computed by passing the result of the previous call as crc.
+     */
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
     
     /// \} /Communications Stuff
 
 
+#pragma mark - Commit Protocol
+
+    /*!
+     \name Commit Protocol
+
+     The CommitRAMToEEPROM action programs the EEPROM from an image that is already running in
+     hub RAM (after loadRAM). The Propeller is not reset and the booter is not involved, so the
+     running firmware must include a hook that implements the following protocol. The hook
+     communicates at the loader's baudrate (8N1). All multibyte values are little-endian.
+
+     1. The host sends a 20 byte commit request: CommitRequestMagic, then four longs -- the image
+        size in bytes (the image's vbase, so only the program is included), the CRC-32 of the
+        image, the stack marker address, and the CRC-32 of the 32 KB EEPROM contents.
+     2. The hook compares the CRC-32 of hub RAM from 0 up to the image size against the image
+        CRC. It replies with a status byte (RAM verification status). If RAM has been modified
+        the hook stops here.
+     3. The hook programs the 32 KB EEPROM using page writes. The EEPROM contents are hub RAM up
+        to the image size, followed by zeroes, except for the two stack marker longs
+        (0xFFF9FFFF) at the stack marker address. This is exactly what the booter would have
+        programmed. It replies with a status byte (EEPROM programming status).
+     4. The hook reads back the 32 KB EEPROM and compares its CRC-32 against the EEPROM CRC. It
+        replies with a status byte (EEPROM verification status).
+
+     The status bytes are CommitStatusSuccess or CommitStatusFailure.
+
+     \see AsyncPropLoader::commitRAMToEEPROM
+     */
+    /// \{
+
+    /*!
+     \brief The first four bytes of a commit request ("APLC").
+     */
+    const std::vector<uint8_t> CommitRequestMagic = {0x41, 0x50, 0x4C, 0x43};
+
+    /*!
+     \brief The status byte sent by the commit hook when a step succeeds.
+     */
+    const uint8_t CommitStatusSuccess = 0x00;
+
+    /*!
+     \brief The status byte sent by the commit hook when a step fails.
+     */
+    const uint8_t CommitStatusFailure = 0x01;
+
+    /*!
+     \brief Fills eepromImage with the 32 KB that the booter would program into the EEPROM for
+     the given image.
+
+     The booter clears hub RAM after the image and inserts two stack marker longs (0xFFF9FFFF)
+     just below dbase. The image's checksum accounts for these markers, so they must be part of
+     the EEPROM contents for the Propeller to boot from it. (These 32 KB are also the hub RAM
+     contents the booter sets up before launching an image.)
+
+     Only the program (up to vbase) is taken from the image, so both .binary and .eeprom style
+     images are accepted.
+
+     Returns the address of the stack markers.
+
+     \throws std::invalid_argument Thrown if the image is invalid, if its header's vbase or
+     dbase is not long-aligned or does not fit the image, or if an .eeprom style image has data
+     after vbase other than the stack markers.
+     */
+    uint32_t composeEEPROMImage(const std::vector<uint8_t>& image, std::vector<uint8_t>& eepromImage);
+
+    /*!
+     \brief Verifies the image and composes the commit request for it.
+
+     \throws std::invalid_argument Thrown if the image is invalid.
+     \see composeEEPROMImage
+     */
+    void composeCommitRequest(const std::vector<uint8_t>& image, std::vector<uint8_t>& request);
+
+    /// \} /Commit Protocol
+
+
+#pragma mark - Helper Protocol
+
+    /*!
+     \name Helper Protocol
+
+     Helper actions (LoadXMM and ProvisionSD) use the booter to load a helper image into RAM. The helper
+     then communicates with the loader at the helper baudrate (8N1) using frames. All
+     multibyte values are little-endian.
+
+     Every frame begins with a header of HelperFrameHeaderSize bytes: the frame type (one byte),
+     then three longs -- the address, the data length, and the CRC-32 of the data -- followed by
+     the CRC-32 of the preceding 13 header bytes. Write and open frames are followed by the
+     data itself (for open frames, the path). The meaning of the address depends on the frame
+     type and the helper.
+
+     The helper answers every frame with a single reply byte. If a header or its data fails
+     its CRC check the helper replies HelperReplyResend once, then discards all input, without
+     replying, until the line has been idle for 5 ms. That resynchronizes it with the next
+     frame. Before resending, the loader leaves the line idle for longer than that after its
+     last frame has drained, and then discards any input it has received (see
+     AsyncPropLoader::HelperResyncWait). The loader sends the frame again up to a limit.
+
+     | Frame            | Data | Helper action                              | Replies              |
+     |------------------|------|--------------------------------------------|----------------------|
+     | HelperFrameHello | no   | none                                       | OK                   |
+     | HelperFrameCheck | no   | compares the CRC of the destination range  | Unchanged or Changed |
+     | HelperFrameWrite | yes  | writes the data, then reads back and       | OK or Error (or      |
+     |                  |      | compares its CRC                           | OutOfOrder, see      |
+     |                  |      |                                            | ProvisionSD below)   |
+     | HelperFrameBoot  | no   | hands off to a cog-resident kernel         | OK or Error          |
+     |                  |      | receiver (see below)                       |                      |
+     | HelperFrameOpen  | yes  | opens (creates or truncates) the file at   | OK or Error          |
+     |                  |      | the path, or selects raw sectors if the    |                      |
+     |                  |      | path is empty                              |                      |
+     | HelperFrameClose | no   | sets the file size to the address, flushes | OK or Error          |
+     |                  |      | and closes the file (or syncs raw writes); |                      |
+     |                  |      | Error unless written up to the address     |                      |
+
+     The loader sends HelperFrameHello frames until the helper replies.
+
+     For LoadXMM, the loader sends a check frame for each payload block. Only the blocks the
+     helper reports as changed are sent in write frames. Finally, the kernel is booted.
+
+     The kernel is a full 32 KB hub RAM image, and the hub-resident helper can not hold it in
+     addition to itself. So the kernel is booted in two steps. First, the loader sends a boot
+     frame with no data, whose length and data CRC are those of the kernel. The helper loads a
+     receiver into a cog, stops everything else, and the receiver replies HelperReplyOK when it
+     is ready. From then on hub RAM belongs to the receiver. Second, the loader sends the raw
+     kernel bytes (no header). The receiver writes them directly into hub RAM from address 0
+     while computing their CRC-32. If the CRC matches it replies HelperReplyOK and launches the
+     kernel as the booter would. Otherwise, or if the line goes idle before all the bytes
+     arrive, it waits for the line to be idle, replies HelperReplyResend, and expects the
+     kernel bytes again. The receiver stays in its cog until the kernel is launched, so the
+     partially overwritten hub RAM does not prevent retries.
+
+     For ProvisionSD, each file is written between an open and a close frame. The address of a
+     write frame is the byte offset within the file, or, for raw sectors, the SD sector number
+     (SDSectorSize bytes per sector). For raw sectors the open frame's address is the starting
+     sector. The helper keeps the next expected address: the open frame sets it to 0 (or the
+     starting sector), and each write frame it accepts advances it past the frame's data.
+
+     Write frames are pipelined: the loader sends up to HelperPipelineDepth write frames before
+     waiting for replies, so the helper receives the next block while writing the previous one
+     to the card. While a file is open, every reply except the reply to the close frame is
+     HelperWriteReplySize bytes: the reply byte, then the helper's next expected address after
+     handling the frame. (That includes HelperReplyResend for a damaged close frame; the loader
+     discards the extra bytes while resynchronizing.) A write frame
+     that is not at the expected address is not written, and gets HelperReplyOutOfOrder. So
+     blocks are always written in order, and every reply is a cumulative acknowledgement of all
+     data below the address it carries. The loader uses only that address, so a late reply to a
+     frame it has already given up on can not be mistaken for the reply to another frame.
+
+     When a write frame is damaged the helper replies HelperReplyResend, and frames sent right
+     behind it are swallowed while the helper waits for idle. (A frame that arrives after the
+     helper has resynchronized gets HelperReplyOutOfOrder instead.) The loader stops sending,
+     waits and discards its input as above, and resends from the expected address. If it had to
+     do that, it resynchronizes once more after the last block is acknowledged, so that no late
+     reply is taken for the reply to the close frame.
+
+     \see AsyncPropLoader::loadXMM, AsyncPropLoader::setHelperBaudrate
+     */
+    /// \{
+
+    const uint8_t HelperFrameHello = 0x01;
+    const uint8_t HelperFrameCheck = 0x02;
+    const uint8_t HelperFrameWrite = 0x03;
+    const uint8_t HelperFrameBoot = 0x04;
+    const uint8_t HelperFrameOpen = 0x05;
+    const uint8_t HelperFrameClose = 0x06;
+
+    const uint8_t HelperReplyOK = 0x06;
+    const uint8_t HelperReplyResend = 0x15;
+    const uint8_t HelperReplyError = 0x18;
+    const uint8_t HelperReplyUnchanged = 0x3D;
+    const uint8_t HelperReplyChanged = 0x21;
+    const uint8_t HelperReplyOutOfOrder = 0x1A;
+
+    /*!
+     \brief The size of a reply to a write frame during ProvisionSD: the reply byte followed by
+     the helper's next expected address.
+     */
+    const size_t HelperWriteReplySize = 5;
+
+    /*!
+     \brief The size of a frame header, including its CRC.
+     */
+    const size_t HelperFrameHeaderSize = 17;
+
+    /*!
+     \brief The payload is divided into blocks of this size (the last block may be smaller).
+
+     This matches the 4 KB erase sector of common SPI flash chips. The helper must be able to
+     buffer one block (HelperPipelineDepth blocks for ProvisionSD). The kernel is not buffered
+     by the helper -- it is streamed directly into hub RAM.
+     */
+    const size_t HelperBlockSize = 4096;
+
+    /*!
+     \brief The maximum number of unacknowledged write frames during ProvisionSD.
+
+     The helper must be able to buffer this many blocks.
+     */
+    const size_t HelperPipelineDepth = 2;
+
+    /*!
+     \brief The size of an SD card sector, which is the unit of raw sector addresses.
+     */
+    const size_t SDSectorSize = 512;
+
+    /*!
+     \brief The maximum length of an SD file path, in bytes.
+     */
+    const size_t MaxSDPathLength = 255;
+
+    /*!
+     \brief Replaces the contents of frame with a frame header.
+     */
+    void composeHelperFrameHeader(uint8_t type, uint32_t address, uint32_t length, uint32_t dataCRC, std::vector<uint8_t>& frame);
+
+    /// \} /Helper Protocol
+
+
 #pragma mark - ActionError
 
     /*!
@@ -175,6 +427,13 @@ namespace APLoader {
          */
         float getEstimatedTotalTime();
 
+        /*!
+         \brief The time taken so far, in floating point seconds.
+
+         Unlike summary.totalTime this includes the time spent in the current stage.
+         */
+        float getElapsedTime();
+
         /*!
          \name Update Functions
          
@@ -183,7 +442,24 @@ namespace APLoader {
          */
         /// \{
 
-        void start(APLoader::Action action, uint32_t baudrate, const simple::Milliseconds& resetDuration, const simple::Milliseconds& bootWaitDuration);
+        void start(APLoader::Action action, uint32_t baudrate, double achievedBaudrate, const simple::Milliseconds& resetDuration, const simple::Milliseconds& bootWaitDuration);
+
+        /*!
+         \brief Called if the action uses a helper.
+         */
+        void setHelperBaudrate(uint32_t helperBaudrate, double achievedHelperBaudrate);
+
+        /*!
+         \brief Called if the action uses a helper.
+
+         kernelSize is the size of the kernel image sent after the boot frame, or 0 if there is none.
+         */
+        void willStreamPayload(size_t payloadSize, size_t numBlocks, size_t kernelSize);
+
+        /*!
+         \brief Called during stage 9 after each payload block is done.
+         */
+        void finishedPayloadBlock(bool wasSkipped);
 
         /*!
          \brief Called if the action requires an image.
@@ -207,6 +483,16 @@ namespace APLoader {
         void endStage5();
         void endStage6();
         void endStage7();
+        void endStage8();
+        void endStage9();
+        void endStage10();
+
+        /*!
+         \brief Called in place of an end* function for a stage the action does not perform.
+
+         The skipped stage is recorded as taking no time. Stage 10 can not be skipped.
+         */
+        void skipStage();
 
         /*!
          \brief Either endOK or endWithError must be called.
@@ -232,6 +518,9 @@ namespace APLoader {
             Stage5,
             Stage6,
             Stage7,
+            Stage8,
+            Stage9,
+            Stage10,
             Finished,
         };
 
@@ -8,7 +8,9 @@
 
 #include "AsyncPropLoader.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <thread>
 #include <sstream>
 #include <iomanip>
@@ -30,6 +32,10 @@ using hserial::HSerialPort;
 // todo: remove profiler after final testing
 
 
+static_assert(APLoader::AsyncPropLoader::MaxBaudrate < ThreeBitProtocolEncoder::MaxBaudrate,
+              "The loader's baudrate limit must leave a margin below the booter's analyzed limit.");
+
+
 namespace APLoader {
 
     static const std::string EmptyString;
@@ -78,6 +84,72 @@ namespace APLoader {
         }
     }
 
+    void AsyncPropLoader::commitRAMToEEPROM(const std::vector<uint8_t>& image) {
+        startAction(Action::CommitRAMToEEPROM, image);
+    }
+
+    void AsyncPropLoader::loadXMM(const std::vector<uint8_t>& helperImage, const std::vector<uint8_t>& payload, uint32_t payloadAddress, const std::vector<uint8_t>& kernelImage) {
+        startAction(Action::LoadXMM, helperImage, [&](Profiler& profiler) {
+            if (payload.empty()) {
+                throw std::invalid_argument("Payload is empty.");
+            }
+            if (payload.size() - 1 > 0xffffffff - payloadAddress) {
+                throw std::invalid_argument("Payload does not fit in the address space at the given address.");
+            }
+            composeEEPROMImage(kernelImage, a_kernelImage); // verifies the kernel image
+            a_payload = payload;
+            a_payloadAddress = payloadAddress;
+            size_t numBlocks = (payload.size() + HelperBlockSize - 1) / HelperBlockSize;
+            profiler.willStreamPayload(payload.size(), numBlocks, a_kernelImage.size());
+        });
+    }
+
+    void AsyncPropLoader::provisionSD(const std::vector<uint8_t>& helperImage, const std::vector<SDFile>& files) {
+        startAction(Action::ProvisionSD, helperImage, [&](Profiler& profiler) {
+            if (files.empty()) {
+                throw std::invalid_argument("No files were given.");
+            }
+            size_t payloadSize = 0;
+            size_t numBlocks = 0;
+            for (const SDFile& file : files) {
+                if (file.path.empty() || file.path.size() > MaxSDPathLength) {
+                    std::stringstream ss;
+                    ss << "Path \"" << file.path << "\" must be between 1 and " << MaxSDPathLength << " bytes long.";
+                    throw std::invalid_argument(ss.str());
+                }
+                if (file.data.size() > 0xffffffff) {
+                    std::stringstream ss;
+                    ss << "File \"" << file.path << "\" is larger than 4 GB.";
+                    throw std::invalid_argument(ss.str());
+                }
+                payloadSize += file.data.size();
+                numBlocks += (file.data.size() + HelperBlockSize - 1) / HelperBlockSize;
+            }
+            a_sdFiles = files;
+            a_payloadAddress = 0;
+            profiler.willStreamPayload(payloadSize, numBlocks, 0);
+        });
+    }
+
+    void AsyncPropLoader::provisionSDRaw(const std::vector<uint8_t>& helperImage, const std::vector<uint8_t>& data, uint32_t startSector) {
+        startAction(Action::ProvisionSD, helperImage, [&](Profiler& profiler) {
+            if (data.empty()) {
+                throw std::invalid_argument("Data is empty.");
+            }
+            size_t numSectors = (data.size() + SDSectorSize - 1) / SDSectorSize;
+            if (numSectors - 1 > 0xffffffff - startSector) {
+                throw std::invalid_argument("Data does not fit in the sector address space at the given sector.");
+            }
+            // A single entry with an empty path means raw sectors.
+            a_sdFiles.assign(1, SDFile());
+            a_sdFiles[0].data = data;
+            a_sdFiles[0].data.resize(numSectors * SDSectorSize, 0);
+            a_payloadAddress = startSector;
+            size_t payloadSize = a_sdFiles[0].data.size();
+            profiler.willStreamPayload(payloadSize, (payloadSize + HelperBlockSize - 1) / HelperBlockSize, 0);
+        });
+    }
+
 
 #pragma mark - Action Control
 
@@ -141,14 +213,64 @@ namespace APLoader {
     }
 
     void AsyncPropLoader::setBaudrate(uint32_t _baudrate) {
+        if (_baudrate == 0) throw std::invalid_argument("Baudrate may not be zero.");
         if (_baudrate > MaxBaudrate) {
             std::stringstream ss;
             ss << "Baudrate may not exceed " << MaxBaudrate << ".";
             throw std::invalid_argument(ss.str());
         }
+        uint32_t baseClock = adapterBaseClock.load();
+        double achieved = achievedBaudrate(_baudrate, baseClock);
+        if (achieved > ThreeBitProtocolEncoder::MaxBaudrate) {
+            std::stringstream ss;
+            ss << "The adapter would produce " << std::fixed << std::setprecision(1) << achieved
+            << " bps for a requested baudrate of " << _baudrate << " bps (adapter base clock " << baseClock
+            << " Hz), which exceeds " << ThreeBitProtocolEncoder::MaxBaudrate << ".";
+            throw std::invalid_argument(ss.str());
+        }
         baudrate.store(_baudrate);
     }
 
+    uint32_t AsyncPropLoader::getAdapterBaseClock() {
+        return adapterBaseClock.load();
+    }
+
+    void AsyncPropLoader::setAdapterBaseClock(uint32_t _baseClock) {
+        if (_baseClock != 0 && _baseClock < MaxBaudrate) {
+            std::stringstream ss;
+            ss << "Adapter base clock must be 0 or at least " << MaxBaudrate << " Hz.";
+            throw std::invalid_argument(ss.str());
+        }
+        uint32_t currentBaudrate = baudrate.load();
+        double achieved = achievedBaudrate(currentBaudrate, _baseClock);
+        if (achieved > ThreeBitProtocolEncoder::MaxBaudrate) {
+            std::stringstream ss;
+            ss << "With an adapter base clock of " << _baseClock << " Hz the adapter would produce "
+            << std::fixed << std::setprecision(1) << achieved << " bps for the current baudrate of "
+            << currentBaudrate << " bps, which exceeds " << ThreeBitProtocolEncoder::MaxBaudrate << ".";
+            throw std::invalid_argument(ss.str());
+        }
+        adapterBaseClock.store(_baseClock);
+    }
+
+    double AsyncPropLoader::getAchievedBaudrate() {
+        return achievedBaudrate(baudrate.load(), adapterBaseClock.load());
+    }
+
+    uint32_t AsyncPropLoader::getHelperBaudrate() {
+        return helperBaudrate.load();
+    }
+
+    void AsyncPropLoader::setHelperBaudrate(uint32_t _helperBaudrate) {
+        if (_helperBaudrate == 0) throw std::invalid_argument("Helper baudrate may not be zero.");
+        if (_helperBaudrate > MaxHelperBaudrate) {
+            std::stringstream ss;
+            ss << "Helper baudrate may not exceed " << MaxHelperBaudrate << ".";
+            throw std::invalid_argument(ss.str());
+        }
+        helperBaudrate.store(_helperBaudrate);
+    }
+
     ResetLine AsyncPropLoader::getResetLine() {
         return resetLine.load();
     }
@@ -201,7 +323,7 @@ namespace APLoader {
 
 #pragma mark - [Internal] Action Lifecycle Functions
 
-    void AsyncPropLoader::startAction(Action action, const std::vector<uint8_t>& image) {
+    void AsyncPropLoader::startAction(Action action, const std::vector<uint8_t>& image, const std::function<void(Profiler&)>& preparePayload) {
         // Called by a public action function (e.g. loadRAM).
 
         if (!actionIsValid(action)) {
@@ -222,23 +344,61 @@ namespace APLoader {
 
         // Lock in the settings.
         a_baudrate = baudrate.load();
+        a_adapterBaseClock = adapterBaseClock.load();
+        a_helperBaudrate = helperBaudrate.load();
         a_resetLine = resetLine.load();
         a_resetCallback = resetCallback.load();
         a_resetDuration = resetDuration.load();
         a_bootWaitDuration = bootWaitDuration.load();
         a_statusMonitor = statusMonitor.load();
 
+        // setBaudrate and setAdapterBaseClock already check the achieved rate, but the settings
+        //  are changed independently so they are checked together again here. MaxBaudrate's
+        //  margin is there to absorb the adapter's rounding, so the achieved rate is checked
+        //  against the booter's limit.
+        a_achievedBaudrate = achievedBaudrate(a_baudrate, a_adapterBaseClock);
+        if (a_achievedBaudrate > ThreeBitProtocolEncoder::MaxBaudrate) {
+            std::stringstream ss;
+            ss << "The achieved baudrate (" << std::fixed << std::setprecision(1) << a_achievedBaudrate
+            << " bps, for a requested baudrate of " << a_baudrate << " bps and an adapter base clock of "
+            << a_adapterBaseClock << " Hz) exceeds " << ThreeBitProtocolEncoder::MaxBaudrate << ".";
+            throw std::invalid_argument(ss.str());
+        }
+
+        // The helper's serial driver does not calibrate to the host, so its achieved rate
+        //  must be close to nominal.
+        a_achievedHelperBaudrate = achievedBaudrate(a_helperBaudrate, a_adapterBaseClock);
+        if (actionUsesHelper(action) && std::abs(a_achievedHelperBaudrate - a_helperBaudrate) > HelperBaudrateTolerance * a_helperBaudrate) {
+            std::stringstream ss;
+            ss << "The achieved helper baudrate (" << std::fixed << std::setprecision(1) << a_achievedHelperBaudrate
+            << " bps, for a requested helper baudrate of " << a_helperBaudrate << " bps and an adapter base clock of "
+            << a_adapterBaseClock << " Hz) is not within " << std::setprecision(0) << (HelperBaudrateTolerance * 100.0)
+            << "% of the requested rate.";
+            throw std::invalid_argument(ss.str());
+        }
+
         a_counter += 1;
 
         Profiler profiler;
-        profiler.start(action, a_baudrate, a_resetDuration, a_bootWaitDuration);
-
-        if (actionRequiresImage(action)) {
+        profiler.start(action, a_baudrate, a_achievedBaudrate, a_resetDuration, a_bootWaitDuration);
+
+        if (action == Action::CommitRAMToEEPROM) {
+            // The image is already in hub RAM, so it is not encoded -- only its size and CRCs
+            //  are sent to the commit hook.
+            composeCommitRequest(image, a_commitRequest);
+            profiler.summary.imageSize = image.size();
+        } else if (actionRequiresImage(action)) {
             profiler.willStartEncodingImage(image.size());
             a_imageSizeInLongs = verifyAndEncodeImage(image, a_encodedImage); // copies the image data
             profiler.finishedEncodingImage(a_encodedImage.size());
         }
 
+        if (actionUsesHelper(action)) {
+            profiler.setHelperBaudrate(a_helperBaudrate, a_achievedHelperBaudrate);
+            assert(preparePayload);
+            preparePayload(profiler); // copies the payload data
+        }
+
         // The action will proceed -- no exceptions from this point on.
         // Design note: by setting a_action to a non-None value before calling makeActive we
         //  ensure that once the controller is made active it can not be made inactive until
@@ -328,26 +488,77 @@ namespace APLoader {
         // Stage 1: Preparation
         a_stage1_preparation(profiler);
 
-        // Stage 2: Reset
-        a_callStatusMonitorLoaderUpdate(profiler, Status::Resetting);
-        a_stage2a_reset(profiler);
-        if (action == Action::Restart) return;
-        a_stage2b_waitAfterReset(profiler);
+        if (action == Action::CommitRAMToEEPROM) {
+
+            // The image is already running, so there is no reset or booter handshake.
+            profiler.skipStage();
+            profiler.skipStage();
+            profiler.skipStage();
+
+            // Stage 4: Send Commit Request (there is no image to send)
+            a_callStatusMonitorLoaderUpdate(profiler, Status::SendingCommitRequest);
+
+            a_checkPoint("discarding input");
+
+            // The running image may have printed output (e.g. self-test results), which must not be
+            //  mistaken for the RAM verification status.
+            a_discardInput(ErrorCode::FailedToFlushInput);
+
+            a_stage4a_sendCommand(profiler);
+            profiler.skipStage();
 
-        // Stage 3: Establish Communications
-        a_callStatusMonitorLoaderUpdate(profiler, Status::EstablishingCommunications);
-        a_stage3_establishComms(profiler);
+            // Stage 5: Wait for RAM Verification Status
+            a_callStatusMonitorLoaderUpdate(profiler, Status::WaitingForRAMVerificationStatus);
+            a_stage5_waitForRAMVerificationStatus(profiler);
 
-        // Stage 4: Send Command and Image
-        a_callStatusMonitorLoaderUpdate(profiler, Status::SendingCommandAndImage);
-        a_stage4a_sendCommand(profiler);
-        if (action == Action::Shutdown) return;
-        a_stage4b_sendImage(profiler);
+        } else {
+
+            // Stage 2: Reset
+            a_callStatusMonitorLoaderUpdate(profiler, Status::Resetting);
+            a_stage2a_reset(profiler);
+            if (action == Action::Restart) return;
+            a_stage2b_waitAfterReset(profiler);
+
+            // Stage 3: Establish Communications
+            a_callStatusMonitorLoaderUpdate(profiler, Status::EstablishingCommunications);
+            a_stage3_establishComms(profiler);
+
+            // Stage 4: Send Command and Image
+            a_callStatusMonitorLoaderUpdate(profiler, Status::SendingCommandAndImage);
+            a_stage4a_sendCommand(profiler);
+            if (action == Action::Shutdown) return;
+            a_stage4b_sendImage(profiler);
+
+            // Stage 5: Wait for Checksum Status
+            a_callStatusMonitorLoaderUpdate(profiler, Status::WaitingForChecksumStatus);
+            a_stage5_waitForChecksumStatus(profiler);
+            if (action == Action::LoadRAM) return;
+        }
+
+        if (actionUsesHelper(action)) {
 
-        // Stage 5: Wait for Checksum Status
-        a_callStatusMonitorLoaderUpdate(profiler, Status::WaitingForChecksumStatus);
-        a_stage5_waitForChecksumStatus(profiler);
-        if (action == Action::LoadRAM) return;
+            // The helper image is now running. There is no EEPROM programming.
+            profiler.skipStage();
+            profiler.skipStage();
+
+            // Stage 8: Establish Helper Communications
+            a_callStatusMonitorLoaderUpdate(profiler, Status::EstablishingHelperCommunications);
+            a_stage8_establishHelperComms(profiler);
+
+            // Stage 9: Stream Payload
+            a_callStatusMonitorLoaderUpdate(profiler, Status::StreamingPayload);
+            if (action == Action::ProvisionSD) {
+                // The helper keeps running -- there is no kernel to boot.
+                a_stage9_streamSDFiles(profiler);
+                return;
+            }
+            a_stage9_streamPayload(profiler);
+
+            // Stage 10: Boot Kernel
+            a_callStatusMonitorLoaderUpdate(profiler, Status::BootingKernel);
+            a_stage10_bootKernel(profiler);
+            return;
+        }
 
         // Stage 6: Wait for EEPROM Programming Status
         a_callStatusMonitorLoaderUpdate(profiler, Status::WaitingForEEPROMProgrammingStatus);
@@ -486,6 +697,8 @@ namespace APLoader {
                 encodedCommand = &EncodedShutdown;
                 break;
             case Action::LoadRAM:
+            case Action::LoadXMM:
+            case Action::ProvisionSD:
                 encodedCommand = &EncodedLoadRAM;
                 break;
             case Action::ProgramEEPROMThenShutdown:
@@ -494,6 +707,10 @@ namespace APLoader {
             case Action::ProgramEEPROMThenRun:
                 encodedCommand = &EncodedProgramEEPROMThenRun;
                 break;
+            case Action::CommitRAMToEEPROM:
+                // The commit request is sent to the commit hook, not the booter.
+                encodedCommand = &a_commitRequest;
+                break;
             default:
                 // Program logic should prevent such commands from reaching this point.
                 assert(false);
@@ -556,11 +773,32 @@ namespace APLoader {
         profiler.endStage5();
     }
 
+    void AsyncPropLoader::a_stage5_waitForRAMVerificationStatus(Profiler& profiler) {
+
+        a_checkPoint("waiting for RAM verification status");
+
+        bool status = a_receiveCommitStatus(CommitRAMVerificationStatusTimeout, ErrorCode::FailedToReceiveRAMVerificationStatus);
+
+        a_checkPoint("checking RAM verification status");
+
+        // true means failure
+        if (status) {
+            throw ActionError(ErrorCode::PropReportsRAMVerificationError, "Hub RAM no longer matches the image. The firmware may have modified itself.");
+        }
+
+        profiler.endStage5();
+    }
+
     void AsyncPropLoader::a_stage6_waitForEEPROMProgrammingStatus(Profiler& profiler) {
 
         a_checkPoint("waiting for EEPROM programming status");
 
-        bool status = a_receiveStatus(EEPROMProgrammingStatusTimeout, ErrorCode::FailedToReceiveEEPROMProgrammingStatus);
+        bool status;
+        if (a_action.load() == Action::CommitRAMToEEPROM) {
+            status = a_receiveCommitStatus(CommitEEPROMProgrammingStatusTimeout, ErrorCode::FailedToReceiveEEPROMProgrammingStatus);
+        } else {
+            status = a_receiveStatus(EEPROMProgrammingStatusTimeout, ErrorCode::FailedToReceiveEEPROMProgrammingStatus);
+        }
 
         a_checkPoint("checking EEPROM programming status");
 
@@ -576,7 +814,12 @@ namespace APLoader {
 
         a_checkPoint("waiting for EEPROM verification status");
 
-        bool status = a_receiveStatus(EEPROMVerificationStatusTimeout, ErrorCode::FailedToReceiveEEPROMVerificationStatus);
+        bool status;
+        if (a_action.load() == Action::CommitRAMToEEPROM) {
+            status = a_receiveCommitStatus(CommitEEPROMVerificationStatusTimeout, ErrorCode::FailedToReceiveEEPROMVerificationStatus);
+        } else {
+            status = a_receiveStatus(EEPROMVerificationStatusTimeout, ErrorCode::FailedToReceiveEEPROMVerificationStatus);
+        }
         
         a_checkPoint("checking EEPROM verification status");
         
@@ -590,6 +833,150 @@ namespace APLoader {
         profiler.endStage7();
     }
 
+    void AsyncPropLoader::a_stage8_establishHelperComms(Profiler& profiler) {
+
+        a_checkPoint("switching to helper baudrate");
+
+        a_switchToHelperBaudrate();
+
+        a_checkPoint("waiting for helper");
+
+        composeHelperFrameHeader(HelperFrameHello, 0, 0, 0, a_helperFrame);
+
+        SteadyTimePoint timeoutTime = SteadyClock::now() + HelperHelloTimeout;
+
+        while (true) {
+
+            a_throwIfCancelled();
+
+            // The helper may not be listening yet, so keep sending hello frames until it replies.
+            a_sendBytes(a_helperFrame, ErrorCode::FailedToEstablishHelperComms);
+
+            std::this_thread::sleep_for(HelperHelloInterval);
+
+            size_t numAvailable;
+            try {
+                numAvailable = available();
+            } catch (const std::exception& e) {
+                std::stringstream ss;
+                ss << "Getting available bytes failed. Error: " << e.what();
+                throw ActionError(ErrorCode::FailedToEstablishHelperComms, ss.str());
+            }
+
+            if (numAvailable > 0) {
+                a_receiveBytes(a_buffer, numAvailable, timeoutTime, ErrorCode::FailedToEstablishHelperComms);
+                // Bytes from a helper that was not ready (or from the baudrate switch) are ignored.
+                if (a_buffer.back() == HelperReplyOK) break;
+            }
+
+            if (timeoutTime < SteadyClock::now()) {
+                throw ActionError(ErrorCode::FailedToEstablishHelperComms, "The helper did not reply. Check that it uses the helper baudrate.");
+            }
+        }
+
+        // Replies to any extra hello frames still in transit are discarded.
+        std::this_thread::sleep_for(HelperHelloInterval);
+        size_t numAvailable;
+        try {
+            numAvailable = available();
+        } catch (const std::exception& e) {
+            std::stringstream ss;
+            ss << "Getting available bytes failed. Error: " << e.what();
+            throw ActionError(ErrorCode::FailedToEstablishHelperComms, ss.str());
+        }
+        if (numAvailable > 0) {
+            a_receiveBytes(a_buffer, numAvailable, SteadyClock::now() + HelperHelloInterval, ErrorCode::FailedToEstablishHelperComms);
+        }
+
+        profiler.endStage8();
+    }
+
+    void AsyncPropLoader::a_stage9_streamPayload(Profiler& profiler) {
+
+        size_t payloadSize = a_payload.size();
+
+        for (size_t offset = 0; offset < payloadSize; offset += HelperBlockSize) {
+
+            a_checkPoint("checking payload block");
+
+            size_t blockSize = std::min(HelperBlockSize, payloadSize - offset);
+            const uint8_t* data = &a_payload[offset];
+            uint32_t address = a_payloadAddress + static_cast<uint32_t>(offset);
+
+            // Ask the helper if the destination already holds this block.
+            composeHelperFrameHeader(HelperFrameCheck, address, static_cast<uint32_t>(blockSize), crc32(data, blockSize), a_helperFrame);
+            uint8_t reply = a_exchangeHelperFrame(a_helperFrame, HelperCheckTimeout, ErrorCode::FailedToSendPayloadBlock, ErrorCode::FailedToReceivePayloadBlockStatus);
+
+            if (reply == HelperReplyUnchanged) {
+                profiler.finishedPayloadBlock(true);
+            } else if (reply == HelperReplyChanged) {
+                a_checkPoint("writing payload block");
+                a_sendHelperData(HelperFrameWrite, address, data, blockSize, HelperWriteTimeout, ErrorCode::FailedToSendPayloadBlock, ErrorCode::FailedToReceivePayloadBlockStatus, ErrorCode::HelperReportsPayloadBlockError);
+                profiler.finishedPayloadBlock(false);
+            } else {
+                std::stringstream ss;
+                ss << std::setw(2) << std::uppercase << std::hex;
+                ss << "Received unexpected reply to check frame: 0x" << static_cast<int>(reply) << ".";
+                throw ActionError(ErrorCode::FailedToReceivePayloadBlockStatus, ss.str());
+            }
+
+            a_callStatusMonitorLoaderUpdate(profiler, Status::StreamingPayload);
+        }
+
+        profiler.endStage9();
+    }
+
+    void AsyncPropLoader::a_stage9_streamSDFiles(Profiler& profiler) {
+
+        for (const SDFile& file : a_sdFiles) {
+
+            a_checkPoint("opening file");
+
+            // An empty path selects raw sectors, with a_payloadAddress as the starting sector.
+            bool isRaw = file.path.empty();
+            uint32_t startAddress = isRaw ? a_payloadAddress : 0;
+            uint32_t addressUnit = isRaw ? static_cast<uint32_t>(SDSectorSize) : 1;
+
+            a_sendHelperData(HelperFrameOpen, startAddress, reinterpret_cast<const uint8_t*>(file.path.data()), file.path.size(), HelperFileTimeout, ErrorCode::FailedToSendFileFrame, ErrorCode::FailedToReceiveFileStatus, ErrorCode::HelperReportsFileError);
+
+            if (!file.data.empty()) {
+                a_writeBlocksPipelined(profiler, file.data, startAddress, addressUnit);
+            }
+
+            a_checkPoint("closing file");
+
+            uint32_t size = static_cast<uint32_t>(file.data.size() / addressUnit);
+            a_sendHelperData(HelperFrameClose, size, nullptr, 0, HelperFileTimeout, ErrorCode::FailedToSendFileFrame, ErrorCode::FailedToReceiveFileStatus, ErrorCode::HelperReportsFileError);
+        }
+
+        a_checkPoint("finishing up");
+
+        profiler.endStage9();
+    }
+
+    void AsyncPropLoader::a_stage10_bootKernel(Profiler& profiler) {
+
+        a_checkPoint("starting kernel receiver");
+
+        // The kernel does not fit in hub RAM alongside the helper, so the boot frame carries no
+        //  data. It describes the kernel, and the helper replies once a cog-resident receiver
+        //  has taken over hub RAM.
+        composeHelperFrameHeader(HelperFrameBoot, 0, static_cast<uint32_t>(a_kernelImage.size()), crc32(a_kernelImage.data(), a_kernelImage.size()), a_helperFrame);
+        uint8_t reply = a_exchangeHelperFrame(a_helperFrame, HelperBootTimeout, ErrorCode::FailedToSendKernel, ErrorCode::FailedToReceiveKernelStatus);
+        a_checkHelperReply(reply, 0, ErrorCode::FailedToReceiveKernelStatus, ErrorCode::HelperReportsKernelError);
+
+        a_checkPoint("sending kernel");
+
+        // The raw kernel bytes go straight into hub RAM. The receiver asks for them again if
+        //  their CRC does not match.
+        reply = a_exchangeHelperFrame(a_kernelImage, HelperBootTimeout, ErrorCode::FailedToSendKernel, ErrorCode::FailedToReceiveKernelStatus);
+        a_checkHelperReply(reply, 0, ErrorCode::FailedToReceiveKernelStatus, ErrorCode::HelperReportsKernelError);
+
+        a_checkPoint("finishing up");
+
+        profiler.endStage10();
+    }
+
 
 #pragma mark - [Internal] Action Thread Helper Functions
 
@@ -632,6 +1019,26 @@ namespace APLoader {
         return drainTime;
     }
 
+    void AsyncPropLoader::a_discardInput(ErrorCode potentialError) {
+
+        while (true) {
+
+            a_throwIfCancelled();
+
+            size_t numAvailable;
+            try {
+                numAvailable = available();
+                if (numAvailable == 0) return;
+                a_buffer.resize(numAvailable);
+                read(a_buffer.data(), numAvailable);
+            } catch (const std::exception& e) {
+                std::stringstream ss;
+                ss << "Discarding input failed. Error: " << e.what();
+                throw ActionError(potentialError, ss.str());
+            }
+        }
+    }
+
     void AsyncPropLoader::a_receiveBytes(std::vector<uint8_t>& buffer, size_t totalToReceive, const SteadyTimePoint& timeoutTime, ErrorCode potentialError) {
 
         if (totalToReceive == 0) {
@@ -753,9 +1160,212 @@ namespace APLoader {
         }
     }
 
+    bool AsyncPropLoader::a_receiveCommitStatus(const simple::Milliseconds& timeout, APLoader::ErrorCode potentialError) {
+
+        a_receiveBytes(a_buffer, 1, SteadyClock::now() + timeout, potentialError);
+
+        uint8_t status = a_buffer[0];
+        if (status == CommitStatusFailure) {
+            return true;
+        } else if (status == CommitStatusSuccess) {
+            return false;
+        } else {
+            // Unexpected byte. Perhaps output from the firmware, or the hook is absent.
+            std::stringstream ss;
+            ss << std::setw(2) << std::uppercase << std::hex;
+            ss << "Received unexpected byte: 0x" << static_cast<int>(status) << ".";
+            throw ActionError(potentialError, ss.str());
+        }
+    }
+
+    uint8_t AsyncPropLoader::a_exchangeHelperFrame(const std::vector<uint8_t>& frame, const simple::Milliseconds& timeout, APLoader::ErrorCode sendError, APLoader::ErrorCode receiveError) {
+
+        for (int attempt = 1; ; ++attempt) {
+
+            SteadyTimePoint drainTime = a_sendBytes(frame, sendError);
+
+            a_receiveBytes(a_buffer, 1, drainTime + timeout, receiveError);
+
+            uint8_t reply = a_buffer[0];
+            if (reply != HelperReplyResend) {
+                return reply;
+            }
+
+            if (attempt >= MaxHelperFrameAttempts) {
+                std::stringstream ss;
+                ss << "The helper requested the frame be resent " << attempt << " times. The connection may be unreliable at the helper baudrate.";
+                throw ActionError(receiveError, ss.str());
+            }
+
+            a_resyncHelper(drainTime);
+        }
+    }
+
+    void AsyncPropLoader::a_resyncHelper(const SteadyTimePoint& drainTime) {
+
+        a_checkPoint("resynchronizing with helper");
+
+        // The helper ignores everything until the line has been idle.
+        a_waitUntil(drainTime + HelperResyncWait);
+
+        a_discardInput(ErrorCode::FailedToFlushInput);
+    }
+
+    void AsyncPropLoader::a_sendHelperData(uint8_t frameType, uint32_t address, const uint8_t* data, size_t size, const simple::Milliseconds& timeout, APLoader::ErrorCode sendError, APLoader::ErrorCode receiveError, APLoader::ErrorCode helperError) {
+
+        composeHelperFrameHeader(frameType, address, static_cast<uint32_t>(size), crc32(data, size), a_helperFrame);
+        a_helperFrame.insert(a_helperFrame.end(), data, data + size);
+
+        uint8_t reply = a_exchangeHelperFrame(a_helperFrame, timeout, sendError, receiveError);
+
+        a_checkHelperReply(reply, address, receiveError, helperError);
+    }
+
+    void AsyncPropLoader::a_checkHelperReply(uint8_t reply, uint32_t address, APLoader::ErrorCode receiveError, APLoader::ErrorCode helperError) {
+
+        if (reply == HelperReplyOK) {
+            return;
+        } else if (reply == HelperReplyError) {
+            std::stringstream ss;
+            ss << "The helper reported an error for the frame with address 0x" << std::setw(8) << std::setfill('0')
+            << std::uppercase << std::hex << address << ".";
+            throw ActionError(helperError, ss.str());
+        } else {
+            std::stringstream ss;
+            ss << std::setw(2) << std::uppercase << std::hex;
+            ss << "Received unexpected reply: 0x" << static_cast<int>(reply) << ".";
+            throw ActionError(receiveError, ss.str());
+        }
+    }
+
+    void AsyncPropLoader::a_writeBlocksPipelined(Profiler& profiler, const std::vector<uint8_t>& data, uint32_t startAddress, uint32_t addressUnit) {
+
+        size_t numBlocks = (data.size() + HelperBlockSize - 1) / HelperBlockSize;
+
+        // The estimated drain times of the outstanding frames, indexed by block number modulo
+        //  the pipeline depth. A frame can not start transmitting until the previous one has
+        //  drained, so the drain times are chained.
+        SteadyTimePoint drainTimes[HelperPipelineDepth];
+        SteadyTimePoint lastDrainTime = SteadyClock::now();
+
+        size_t nextToSend = 0;
+        size_t numAcked = 0;        // the number of blocks the helper is known to hold
+        size_t numOutstanding = 0;  // frames sent since the last resync whose replies have not been read
+        int attempts = 1;           // for block numAcked
+        bool didResync = false;
+
+        while (numAcked < numBlocks || numOutstanding > 0) {
+
+            // Keep the pipeline full, so the helper receives the next block while it writes the
+            //  previous one to the card.
+            while (nextToSend < numBlocks && numOutstanding < HelperPipelineDepth) {
+
+                a_checkPoint("sending payload block");
+
+                size_t offset = nextToSend * HelperBlockSize;
+                size_t blockSize = std::min(HelperBlockSize, data.size() - offset);
+                const uint8_t* blockData = &data[offset];
+                uint32_t address = startAddress + static_cast<uint32_t>(offset / addressUnit);
+
+                composeHelperFrameHeader(HelperFrameWrite, address, static_cast<uint32_t>(blockSize), crc32(blockData, blockSize), a_helperFrame);
+                a_helperFrame.insert(a_helperFrame.end(), blockData, blockData + blockSize);
+
+                SteadyTimePoint now = SteadyClock::now();
+                a_sendBytes(a_helperFrame, ErrorCode::FailedToSendPayloadBlock);
+                lastDrainTime = std::max(now, lastDrainTime) + a_transitDuration(a_helperFrame.size());
+                drainTimes[nextToSend % HelperPipelineDepth] = lastDrainTime;
+
+                nextToSend += 1;
+                numOutstanding += 1;
+            }
+
+            if (numOutstanding == 0) {
+                throw ActionError(ErrorCode::FailedToReceivePayloadBlockStatus, "BUG: no outstanding frames in a_writeBlocksPipelined.");
+            }
+
+            a_checkPoint("waiting for payload block status");
+
+            // Replies are in order, so this is nominally the reply to the oldest outstanding frame.
+            size_t block = nextToSend - numOutstanding;
+            a_receiveBytes(a_buffer, HelperWriteReplySize, drainTimes[block % HelperPipelineDepth] + HelperWriteTimeout, ErrorCode::FailedToReceivePayloadBlockStatus);
+            numOutstanding -= 1;
+
+            uint8_t reply = a_buffer[0];
+            uint32_t expectedAddress = a_buffer[1] | (a_buffer[2] << 8) | (a_buffer[3] << 16) | (static_cast<uint32_t>(a_buffer[4]) << 24);
+
+            if (reply == HelperReplyError) {
+                std::stringstream ss;
+                ss << "The helper failed to write the block at address 0x" << std::setw(8) << std::setfill('0')
+                << std::uppercase << std::hex << expectedAddress << ". The card may be full, write-protected, or absent.";
+                throw ActionError(ErrorCode::HelperReportsPayloadBlockError, ss.str());
+            }
+
+            if (reply != HelperReplyOK && reply != HelperReplyOutOfOrder && reply != HelperReplyResend) {
+                std::stringstream ss;
+                ss << std::setw(2) << std::uppercase << std::hex;
+                ss << "Received unexpected reply: 0x" << static_cast<int>(reply) << ".";
+                throw ActionError(ErrorCode::FailedToReceivePayloadBlockStatus, ss.str());
+            }
+
+            // The expected address acknowledges everything below it. It must be at a block
+            //  boundary (or the end of the data).
+            uint64_t heldBytes = static_cast<uint64_t>(expectedAddress - startAddress) * addressUnit;
+            if (expectedAddress < startAddress || heldBytes > data.size() || (heldBytes % HelperBlockSize != 0 && heldBytes != data.size())) {
+                std::stringstream ss;
+                ss << "The helper reported an unexpected address: 0x" << std::setw(8) << std::setfill('0')
+                << std::uppercase << std::hex << expectedAddress << ".";
+                throw ActionError(ErrorCode::FailedToReceivePayloadBlockStatus, ss.str());
+            }
+            size_t numHeld = static_cast<size_t>((heldBytes + HelperBlockSize - 1) / HelperBlockSize);
+
+            if (numHeld > numAcked) {
+                while (numAcked < numHeld) {
+                    profiler.finishedPayloadBlock(false);
+                    numAcked += 1;
+                }
+                attempts = 1;
+                a_callStatusMonitorLoaderUpdate(profiler, Status::StreamingPayload);
+            }
+
+            // A reply whose address is below what is already acknowledged is a late reply to a
+            //  frame from before a resync, and is ignored. Otherwise a resend request, or an
+            //  out of order report showing that the helper is missing data sent before this
+            //  frame, means the helper needs the data from its expected address again. (An out
+            //  of order report with the address of this very frame can only be a late one.)
+            bool isStale = numHeld < numAcked;
+            bool needsRewind = !isStale && (reply == HelperReplyResend || (reply == HelperReplyOutOfOrder && numHeld < block));
+
+            if (needsRewind) {
+
+                if (numAcked < numBlocks) {
+                    if (attempts >= MaxHelperFrameAttempts) {
+                        std::stringstream ss;
+                        ss << "The helper requested the frame be resent " << attempts << " times. The connection may be unreliable at the helper baudrate.";
+                        throw ActionError(ErrorCode::FailedToReceivePayloadBlockStatus, ss.str());
+                    }
+                    attempts += 1;
+                }
+
+                // The helper swallows the frames sent after a damaged one, without replying,
+                //  until the line goes idle. Stop sending, let it resynchronize, and go back to
+                //  its expected address.
+                a_resyncHelper(lastDrainTime);
+                didResync = true;
+                numOutstanding = 0;
+                nextToSend = numAcked;
+            }
+        }
+
+        if (didResync) {
+            // Late replies to frames sent before a resync may still arrive. Make sure none is
+            //  taken for the reply to the next frame.
+            a_resyncHelper(lastDrainTime);
+        }
+    }
+
     void AsyncPropLoader::a_callStatusMonitorLoaderUpdate(Profiler& profiler, Status status) {
         if (a_statusMonitor) {
-            a_statusMonitor->loaderUpdate(*this, status, profiler.summary.totalTime, profiler.getEstimatedTotalTime()); // noexcept
+            a_statusMonitor->loaderUpdate(*this, status, profiler.getElapsedTime(), profiler.getEstimatedTotalTime()); // noexcept
         }
     }
 
@@ -798,6 +1408,24 @@ namespace APLoader {
         }
     }
 
+    void AsyncPropLoader::a_switchToHelperBaudrate() {
+
+        // Bytes still in the output buffer would be garbled by the switch.
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            throw ActionError(ErrorCode::FailedToFlushOutput, e.what());
+        }
+
+        try {
+            HSerialController::setBaudrate(a_helperBaudrate, true);
+        } catch (const std::exception& e) {
+            throw ActionError(ErrorCode::FailedToSetBaudrate, e.what());
+        }
+
+        a_achievedBaudrate = a_achievedHelperBaudrate;
+    }
+
     void AsyncPropLoader::a_doReset() {
         if (a_resetLine == ResetLine::DTR) {
             setDTR(true);
@@ -859,7 +1487,7 @@ namespace APLoader {
     }
 
     Microseconds AsyncPropLoader::a_transitDuration(size_t numBytes) {
-        long long n = numBytes * 10000000.0f / a_baudrate;
+        long long n = static_cast<long long>(numBytes * 10000000.0 / a_achievedBaudrate);
         if (n < 1) n = 1;
         return Microseconds(n);
     }
@@ -10,6 +10,8 @@
 #define AsyncPropLoader_hpp
 
 
+#include <functional>
+
 #include "HSerialController.hpp"
 #include "APLoaderDefs.hpp"
 #include "SimpleChrono.hpp"
@@ -74,6 +76,7 @@ namespace APLoader {
          Use an APLoader::StatusMonitor object to follow the progress of the action.
          It may be cancelled with cancel() or cancelAndWait().
 
+         \throws std::invalid_argument Thrown if the achieved baudrate is too fast (see setBaudrate).
          \throws simple::IsBusyError Thrown if there is an action already in progress.
          \see APLoader::StatusMonitor, shutdown, loadRAM, programEEPROM
          */
@@ -89,6 +92,7 @@ namespace APLoader {
          Use an APLoader::StatusMonitor object to follow the progress of the action.
          It may be cancelled with cancel() or cancelAndWait().
 
+         \throws std::invalid_argument Thrown if the achieved baudrate is too fast (see setBaudrate).
          \throws simple::IsBusyError Thrown if there is an action already in progress.
          \see APLoader::StatusMonitor, restart, loadRAM, programEEPROM
          */
@@ -104,7 +108,7 @@ namespace APLoader {
          It may be cancelled with cancel() or cancelAndWait().
 
          \throws std::invalid_argument Thrown if the image is empty, its size exceeds 32768, or
-         it has an incorrect checksum.
+         it has an incorrect checksum. Also thrown if the achieved baudrate is too fast (see setBaudrate).
          \throws simple::IsBusyError Thrown if there is an action already in progress.
          \see APLoader::StatusMonitor, restart, shutdown, programEEPROM
          */
@@ -123,12 +127,122 @@ namespace APLoader {
          It may be cancelled with cancel() or cancelAndWait().
 
          \throws std::invalid_argument Thrown if the image is empty, its size exceeds 32768, or
-         it has an incorrect checksum.
+         it has an incorrect checksum. Also thrown if the achieved baudrate is too fast (see setBaudrate).
          \throws simple::IsBusyError Thrown if there is an action already in progress.
          \see APLoader::StatusMonitor, restart, shutdown, loadRAM
          */
         void programEEPROM(const std::vector<uint8_t>& image, bool runAfterwards = true);
 
+        /*!
+         \brief Programs the EEPROM with the given image, which is already running in hub RAM.
+
+         This action is intended for a load-test-commit flow: the image is loaded with loadRAM,
+         the running firmware is tested, and then this action programs the EEPROM without
+         resetting the Propeller or sending the image again.
+
+         The running firmware must include a hook that implements the commit protocol (see
+         APLoader::CommitRequestMagic). The hook checks that hub RAM still matches the image,
+         programs the EEPROM with the same contents the booter would have, and verifies it.
+         Progress is reported using the same status values and error codes as programEEPROM,
+         except for the RAM verification stage, which takes the place of the checksum stage.
+
+         The port should stay open after the loadRAM action, since opening the port may toggle
+         the reset line on some systems. Firmware that modifies its code or DAT areas while
+         running will fail RAM verification -- use programEEPROM in that case.
+
+         The image data is copied before returning.
+
+         The action is performed asynchronously.
+         Use an APLoader::StatusMonitor object to follow the progress of the action.
+         It may be cancelled with cancel() or cancelAndWait().
+
+         \throws std::invalid_argument Thrown if the image is empty, its size exceeds 32768, it
+         has an incorrect checksum, or its header is invalid. Also thrown if the achieved
+         baudrate exceeds MaxBaudrate.
+         \throws simple::IsBusyError Thrown if there is an action already in progress.
+         \see APLoader::StatusMonitor, loadRAM, programEEPROM
+         */
+        void commitRAMToEEPROM(const std::vector<uint8_t>& image);
+
+        /*!
+         \brief Loads a large program into external memory (XMM) and boots its kernel.
+
+         This action uses the booter to load helperImage into RAM (as loadRAM does). The helper
+         must implement the helper protocol (see APLoader::HelperFrameHello). The loader then
+         switches to the helper baudrate and streams the payload to the helper in CRC-framed
+         blocks of APLoader::HelperBlockSize bytes, starting at payloadAddress. Blocks that
+         the helper reports as already holding the same data are skipped. Finally, the helper
+         hands off to a cog-resident receiver, which streams kernelImage directly into hub RAM,
+         checks its CRC, and launches it.
+
+         The meaning of payloadAddress depends on the helper (e.g. PropGCC places external
+         flash at 0x30000000).
+
+         Progress is reported to the status monitor after each block (see
+         APLoader::Status::StreamingPayload).
+
+         The image and payload data are copied before returning.
+
+         The action is performed asynchronously.
+         Use an APLoader::StatusMonitor object to follow the progress of the action.
+         It may be cancelled with cancel() or cancelAndWait().
+
+         \throws std::invalid_argument Thrown if either image is invalid (see loadRAM), if
+         the payload is empty or does not fit in the 32-bit address space at payloadAddress,
+         if the achieved baudrate is too fast (see setBaudrate), or if the achieved helper baudrate is not
+         within HelperBaudrateTolerance of the helper baudrate.
+         \throws simple::IsBusyError Thrown if there is an action already in progress.
+         \see APLoader::StatusMonitor, setHelperBaudrate, loadRAM
+         */
+        void loadXMM(const std::vector<uint8_t>& helperImage, const std::vector<uint8_t>& payload, uint32_t payloadAddress, const std::vector<uint8_t>& kernelImage);
+
+        /*!
+         \brief Writes files to the SD card of a Propeller board.
+
+         This action uses the booter to load helperImage into RAM (as loadRAM does). The helper
+         must implement the helper protocol (see APLoader::HelperFrameHello), including a FAT
+         file system. The loader then switches to the helper baudrate and streams each file to
+         the helper, which creates (or replaces) it on the card.
+
+         Writes are pipelined -- the next block is transmitted while the helper writes the
+         previous one to the card. The resulting throughput is reported in
+         APLoader::ActionSummary::payloadThroughput.
+
+         Progress is reported to the status monitor after each block (see
+         APLoader::Status::StreamingPayload). The helper keeps running after the action
+         finishes.
+
+         The image and file data are copied before returning.
+
+         The action is performed asynchronously.
+         Use an APLoader::StatusMonitor object to follow the progress of the action.
+         It may be cancelled with cancel() or cancelAndWait().
+
+         \throws std::invalid_argument Thrown if the helper image is invalid (see loadRAM), if
+         there are no files, if a path is empty or longer than APLoader::MaxSDPathLength, if a
+         file is larger than 4 GB, if the achieved baudrate is too fast (see setBaudrate), or if the
+         achieved helper baudrate is not within HelperBaudrateTolerance of the helper baudrate.
+         \throws simple::IsBusyError Thrown if there is an action already in progress.
+         \see APLoader::StatusMonitor, APLoader::SDFile, provisionSDRaw, setHelperBaudrate
+         */
+        void provisionSD(const std::vector<uint8_t>& helperImage, const std::vector<APLoader::SDFile>& files);
+
+        /*!
+         \brief Writes raw sectors to the SD card of a Propeller board.
+
+         This action is the same as provisionSD, except that the data is written directly to
+         the card's sectors, beginning at startSector, without a file system. The data is
+         padded with zeroes to a whole number of sectors (APLoader::SDSectorSize bytes).
+
+         \throws std::invalid_argument Thrown if the helper image is invalid (see loadRAM), if
+         the data is empty or does not fit in the 32-bit sector address space at startSector, if
+         the achieved baudrate is too fast (see setBaudrate), or if the achieved helper baudrate is not
+         within HelperBaudrateTolerance of the helper baudrate.
+         \throws simple::IsBusyError Thrown if there is an action already in progress.
+         \see provisionSD
+         */
+        void provisionSDRaw(const std::vector<uint8_t>& helperImage, const std::vector<uint8_t>& data, uint32_t startSector);
+
         /// \} /Loader Actions
 
 
@@ -199,14 +313,77 @@ namespace APLoader {
          Since the booter communicates using the 3-Bit-Protocol (3BP) the actual throughput
          is lower than would be expected.
          
-         The default is 115200 bps. This is also the maximum that can be safely supported
-         by the Propeller's booter program.
+         The default is 115200 bps (DefaultBaudrate). Non-standard baudrates up to MaxBaudrate
+         (130000 bps) may be used if the serial adapter and its driver support them.
+
+         The rate the adapter actually produces may differ slightly from the requested rate (see
+         setAdapterBaseClock). MaxBaudrate leaves a margin for that difference: the achieved
+         rate must not exceed the booter's limit, ThreeBitProtocolEncoder::MaxBaudrate.
 
-         \throws std::invalid_argument Thrown if the baudrate exceeds the maximum allowed rate.
-         \see MaxBaudrate, getBaudrate
+         \throws std::invalid_argument Thrown if the baudrate is zero or exceeds MaxBaudrate, or
+         if the achieved rate with the current adapter base clock would exceed
+         ThreeBitProtocolEncoder::MaxBaudrate.
+         \see MaxBaudrate, DefaultBaudrate, getBaudrate, getAchievedBaudrate
          */
         void setBaudrate(uint32_t baudrate);
 
+        /*!
+         \brief Gets the serial adapter's base clock.
+         \see setAdapterBaseClock
+         */
+        uint32_t getAdapterBaseClock();
+
+        /*!
+         \brief Sets the serial adapter's base clock, in Hz.
+
+         Serial adapters produce a baudrate by dividing a base clock, so a non-standard baudrate
+         is usually only approximated. The loader uses the base clock to determine the baudrate
+         the adapter will actually achieve. That rate is checked against
+         ThreeBitProtocolEncoder::MaxBaudrate and is used for all timing calculations.
+
+         The default is 3 MHz (DefaultAdapterBaseClock), which is correct for FTDI adapters
+         such as the Prop Plug. Setting the base clock to 0 means that the adapter is assumed to
+         produce the requested baudrate exactly.
+
+         \throws std::invalid_argument Thrown if the base clock is non-zero but less than
+         MaxBaudrate, or if the achieved rate for the current baudrate would exceed
+         ThreeBitProtocolEncoder::MaxBaudrate.
+         \see getAdapterBaseClock, getAchievedBaudrate
+         */
+        void setAdapterBaseClock(uint32_t baseClock);
+
+        /*!
+         \brief Returns the baudrate the serial adapter is expected to actually produce given
+         the current baudrate and adapter base clock settings.
+         \see setBaudrate, setAdapterBaseClock
+         */
+        double getAchievedBaudrate();
+
+        /*!
+         \brief Gets the helper baudrate.
+         \see setHelperBaudrate
+         */
+        uint32_t getHelperBaudrate();
+
+        /*!
+         \brief Sets the helper baudrate.
+
+         This is the baudrate used to communicate with a helper image after it has been loaded
+         with the booter (e.g. by loadXMM). The helper runs from the crystal clock with its own
+         serial driver, so the booter's limit (MaxBaudrate) does not apply. The helper must be
+         built to use the same baudrate.
+
+         The default is 921600 bps (DefaultHelperBaudrate).
+
+         The achieved helper baudrate (see setAdapterBaseClock) must be within
+         HelperBaudrateTolerance of this rate, which is checked when a helper action is started.
+
+         \throws std::invalid_argument Thrown if the baudrate is zero or exceeds
+         MaxHelperBaudrate.
+         \see getHelperBaudrate
+         */
+        void setHelperBaudrate(uint32_t helperBaudrate);
+
         /*!
          \brief Gets the control line used to reset the Propeller.
          \see APLoader::ResetLine, setResetLine
@@ -309,11 +486,14 @@ namespace APLoader {
         /*!
          \brief The maximum baudrate the loader will operate at.
 
-         Analysis of the Propeller's booter program determined that 115200 bps is the fastest
-         commonly supported baudrate that can be used reliably over the entire RCFAST frequency
-         range, given a large allowance for jitter (±10%).
+         Analysis of the Propeller's booter program determined that 133333 bps is the fastest
+         baudrate that can be used reliably over the entire RCFAST frequency range, given a
+         large allowance for jitter (±10%). The loader's limit is approximately 2.5% below that.
+         The requested baudrate must be at or below this limit. The margin absorbs the rounding
+         of the serial adapter, so the rate the adapter actually achieves is only required to be
+         at or below ThreeBitProtocolEncoder::MaxBaudrate.
 
-         Even though it might work -- or appear to work -- exceeding 115200 bps is unwise because
+         Even though it might work -- or appear to work -- exceeding this limit is unwise because
          the booter program uses a relatively weak error detection mechanism (a one byte checksum
          for a 32 Kbyte image). If faster loading is desired then a bootstrapping loader should
          be used.
@@ -323,9 +503,34 @@ namespace APLoader {
          Note that this limit must not exceed the assumed limit used to prepare
          APLoader::InitBytes.
          
-         \see ThreeBitProtocolEncoder::MaxBaudrate, APLoader::InitBytes
+         \see ThreeBitProtocolEncoder::MaxBaudrate, APLoader::InitBytes, setAdapterBaseClock
+         */
+        static const uint32_t MaxBaudrate = 130000;
+
+        /*!
+         \brief The default baudrate.
+
+         115200 bps is the fastest commonly supported baudrate below MaxBaudrate.
+         */
+        static const uint32_t DefaultBaudrate = 115200;
+
+        /*!
+         \brief The default adapter base clock (3 MHz), which is used by FTDI adapters.
+         \see setAdapterBaseClock
+         */
+        static const uint32_t DefaultAdapterBaseClock = 3000000;
+
+        /*!
+         \brief The default helper baudrate.
+         \see setHelperBaudrate
+         */
+        static const uint32_t DefaultHelperBaudrate = 921600;
+
+        /*!
+         \brief The maximum helper baudrate (the fastest rate of common FTDI adapters).
+         \see setHelperBaudrate
          */
-        static const uint32_t MaxBaudrate = 115200;
+        static const uint32_t MaxHelperBaudrate = 3000000;
 
         /// \} /Constants
 
@@ -434,6 +639,105 @@ namespace APLoader {
          */
         const simple::Milliseconds EEPROMVerificationStatusTimeout {2500};
 
+        /*!
+         \brief Timeout for receiving the RAM verification status code from the commit hook.
+
+         The hook computes the CRC-32 of at most 32 KB of hub RAM. This is fast if done in PASM,
+         but a straightforward Spin implementation may take several seconds.
+
+         \see APLoader::CommitRequestMagic
+         */
+        const simple::Milliseconds CommitRAMVerificationStatusTimeout {5000};
+
+        /*!
+         \brief Timeout for receiving the EEPROM programming status code from the commit hook.
+
+         Programming 512 pages at about 5 ms each takes about 2.6 seconds, plus the I2C
+         transfer time (which depends on the hook's bus speed).
+         */
+        const simple::Milliseconds CommitEEPROMProgrammingStatusTimeout {10000};
+
+        /*!
+         \brief Timeout for receiving the EEPROM verification status code from the commit hook.
+
+         Reading back 32 KB takes about 3.3 seconds at 100 kHz.
+         */
+        const simple::Milliseconds CommitEEPROMVerificationStatusTimeout {6000};
+
+        /*!
+         \brief The interval between hello frames sent while waiting for the helper to start.
+
+         The helper is launched by the booter after the checksum status is sent, and then it
+         needs some time to start its serial driver.
+         */
+        const simple::Milliseconds HelperHelloInterval {50};
+
+        /*!
+         \brief Timeout for the helper to answer a hello frame.
+         */
+        const simple::Milliseconds HelperHelloTimeout {2000};
+
+        /*!
+         \brief Timeout for a reply to a check frame, measured from the estimated drain time
+         of the frame.
+
+         The helper reads back one block and computes its CRC-32.
+         */
+        const simple::Milliseconds HelperCheckTimeout {1000};
+
+        /*!
+         \brief Timeout for a reply to a write frame, measured from the estimated drain time
+         of the frame.
+
+         Erasing a 4 KB SPI flash sector typically takes 45 ms, but may take up to 400 ms. Then
+         the block is programmed and read back.
+         */
+        const simple::Milliseconds HelperWriteTimeout {3000};
+
+        /*!
+         \brief Timeout for a reply to a boot frame or to the kernel bytes, measured from the
+         estimated drain time.
+
+         Loading the receiver into a cog takes well under a millisecond, and the receiver
+         computes the kernel's CRC as the bytes arrive, so either reply should come almost
+         immediately. The timeout mostly covers adapter and driver latency, plus the idle
+         period the receiver waits for before asking for a resend.
+         */
+        const simple::Milliseconds HelperBootTimeout {1000};
+
+        /*!
+         \brief Timeout for a reply to an open or close frame, measured from the estimated
+         drain time of the frame.
+
+         Opening may require searching a directory and freeing the clusters of an existing
+         file. Closing flushes the FAT and the directory entry.
+         */
+        const simple::Milliseconds HelperFileTimeout {3000};
+
+        /*!
+         \brief How long the line is left idle, after the last frame has drained, before a
+         frame is resent.
+
+         After asking for a resend the helper discards input until the line has been idle for
+         5 ms. The rest covers the error in the drain time estimate and adapter latency.
+         */
+        const simple::Milliseconds HelperResyncWait {50};
+
+        /*!
+         \brief The number of times a frame is sent before giving up, if the helper keeps
+         replying APLoader::HelperReplyResend.
+         */
+        const int MaxHelperFrameAttempts = 3;
+
+        /*!
+         \brief The largest allowed relative difference between the helper baudrate and the
+         rate the adapter achieves.
+
+         Unlike the booter, which calibrates to the host, the helper's serial driver expects
+         the nominal baudrate.
+         */
+        const double HelperBaudrateTolerance = 0.02;
+
         /*!
          \brief Helps determine the responsiveness timeout used for sending bytes.
 
@@ -480,10 +784,14 @@ namespace APLoader {
          \brief The helper function called by the action initiating functions (e.g. loadRAM).
          
          This function does some preparation and creates the worker thread.
+
+         For helper actions, preparePayload is called with a_mutex locked after the settings
+         have been locked in. It should copy the action's parameters into the action parameter
+         variables and inform the profiler. It may throw std::invalid_argument.
          
          \see actionThread
          */
-        void startAction(APLoader::Action action, const std::vector<uint8_t>& image);
+        void startAction(APLoader::Action action, const std::vector<uint8_t>& image, const std::function<void(Profiler&)>& preparePayload = nullptr);
 
         /*!
          \brief The entry function for the thread created to perform the action.
@@ -542,8 +850,13 @@ namespace APLoader {
         void a_stage4a_sendCommand(Profiler& profiler);
         void a_stage4b_sendImage(Profiler& profiler);
         void a_stage5_waitForChecksumStatus(Profiler& profiler);
+        void a_stage5_waitForRAMVerificationStatus(Profiler& profiler);
         void a_stage6_waitForEEPROMProgrammingStatus(Profiler& profiler);
         void a_stage7_waitForEEPROMVerificationStatus(Profiler& profiler);
+        void a_stage8_establishHelperComms(Profiler& profiler);
+        void a_stage9_streamPayload(Profiler& profiler);
+        void a_stage9_streamSDFiles(Profiler& profiler);
+        void a_stage10_bootKernel(Profiler& profiler);
 
         /// \} /[Internal] Action Work Functions
 
@@ -569,6 +882,13 @@ namespace APLoader {
          */
         void a_receiveBytes(std::vector<uint8_t>& buffer, size_t totalToReceive, const simple::SteadyTimePoint& timeoutTime, APLoader::ErrorCode potentialError);
 
+        /*!
+         \brief Reads and discards bytes until none are available.
+
+         flush() can not be relied on for this, since on POSIX it only drains the output.
+         */
+        void a_discardInput(APLoader::ErrorCode potentialError);
+
         /*!
          \brief Receives a status code from the Propeller.
 
@@ -585,16 +905,84 @@ namespace APLoader {
          */
         bool a_receiveStatus(const simple::Milliseconds& timeout, APLoader::ErrorCode potentialError);
 
+        /*!
+         \brief Receives a status code from the commit hook.
+
+         Unlike the booter, the commit hook does not need transmission prompts. It sends
+         a single status byte after completing each step.
+
+         As with a_receiveStatus, the return value is `true` for failure.
+
+         \see APLoader::CommitStatusSuccess, APLoader::CommitStatusFailure
+         */
+        bool a_receiveCommitStatus(const simple::Milliseconds& timeout, APLoader::ErrorCode potentialError);
+
+        /*!
+         \brief Sends a helper frame (or the raw kernel bytes) and returns the helper's reply.
+
+         If the helper replies APLoader::HelperReplyResend the frame is sent again, up to
+         MaxHelperFrameAttempts times. Any other reply is returned.
+
+         The timeout is measured from the estimated drain time of the frame.
+
+         \see APLoader::composeHelperFrameHeader
+         */
+        uint8_t a_exchangeHelperFrame(const std::vector<uint8_t>& frame, const simple::Milliseconds& timeout, APLoader::ErrorCode sendError, APLoader::ErrorCode receiveError);
+
+        /*!
+         \brief Sends a helper frame carrying data, and throws unless the helper replies
+         APLoader::HelperReplyOK.
+
+         If the helper replies APLoader::HelperReplyError then helperError is thrown.
+         */
+        void a_sendHelperData(uint8_t frameType, uint32_t address, const uint8_t* data, size_t size, const simple::Milliseconds& timeout, APLoader::ErrorCode sendError, APLoader::ErrorCode receiveError, APLoader::ErrorCode helperError);
+
+        /*!
+         \brief Throws unless the reply is APLoader::HelperReplyOK.
+
+         If the reply is APLoader::HelperReplyError then helperError is thrown, otherwise
+         receiveError is thrown. The address is used in the error message.
+         */
+        void a_checkHelperReply(uint8_t reply, uint32_t address, APLoader::ErrorCode receiveError, APLoader::ErrorCode helperError);
+
+        /*!
+         \brief Prepares to resend after the helper replied APLoader::HelperReplyResend.
+
+         Waits until HelperResyncWait after drainTime, the estimated drain time of the last
+         frame sent, so that the helper sees an idle line. Then discards any input.
+         */
+        void a_resyncHelper(const simple::SteadyTimePoint& drainTime);
+
         /*!
          \brief Calls the status monitor's update callback.
          */
         void a_callStatusMonitorLoaderUpdate(Profiler& profiler, APLoader::Status status);
 
+        /*!
+         \brief Sends the data to the helper in pipelined write frames.
+
+         Each block's address is startAddress plus its offset divided by addressUnit (1 for
+         byte offsets, APLoader::SDSectorSize for raw sectors).
+
+         Progress is tracked by the expected address in each reply, which acknowledges all data
+         below it, so late replies from before a resend can not be matched to the wrong block.
+
+         \see APLoader::HelperPipelineDepth
+         */
+        void a_writeBlocksPipelined(Profiler& profiler, const std::vector<uint8_t>& data, uint32_t startAddress, uint32_t addressUnit);
+
         /*!
          \brief Applies the loader's settings to the serial port.
          */
         void a_updatePortSettings();
 
+        /*!
+         \brief Switches the serial port to the helper baudrate.
+
+         Also updates a_achievedBaudrate, so subsequent transit durations are correct.
+         */
+        void a_switchToHelperBaudrate();
+
         /*!
          \brief Performs the reset.
          */
@@ -617,6 +1005,8 @@ namespace APLoader {
 
         /*!
          \brief The time taken (NB: in microseconds) to transmit the bytes at the current baudrate.
+
+         The achieved baudrate (a_achievedBaudrate) is used, not the requested baudrate.
          */
         simple::Microseconds a_transitDuration(size_t numBytes);
 
@@ -670,7 +1060,9 @@ namespace APLoader {
          */
         /// \{
 
-        std::atomic<uint32_t> baudrate {MaxBaudrate};
+        std::atomic<uint32_t> baudrate {DefaultBaudrate};
+        std::atomic<uint32_t> adapterBaseClock {DefaultAdapterBaseClock};
+        std::atomic<uint32_t> helperBaudrate {DefaultHelperBaudrate};
         std::atomic<APLoader::ResetLine> resetLine {APLoader::ResetLine::DTR};
         std::atomic<APLoader::ResetCallback> resetCallback {NULL};
         std::atomic<simple::Milliseconds> resetDuration {simple::Milliseconds(10)};
@@ -692,12 +1084,33 @@ namespace APLoader {
         /// \{
 
         uint32_t a_baudrate;
+        uint32_t a_adapterBaseClock;
+        uint32_t a_helperBaudrate;
         APLoader::ResetLine a_resetLine;
         APLoader::ResetCallback a_resetCallback;
         simple::Milliseconds a_resetDuration;
         simple::Milliseconds a_bootWaitDuration;
         APLoader::StatusMonitor* a_statusMonitor;
 
+        /*!
+         \brief The baudrate the adapter is expected to actually produce for a_baudrate.
+
+         Derived from a_baudrate and a_adapterBaseClock in startAction.
+
+         \see a_transitDuration, APLoader::achievedBaudrate
+         */
+        double a_achievedBaudrate;
+
+        /*!
+         \brief The baudrate the adapter is expected to actually produce for a_helperBaudrate.
+
+         Derived in startAction. a_achievedBaudrate is switched to this value when the port is
+         switched to the helper baudrate.
+
+         \see a_switchToHelperBaudrate
+         */
+        double a_achievedHelperBaudrate;
+
         /// \} /[Internal] Action Settings
 
 
@@ -838,6 +1251,38 @@ namespace APLoader {
          */
         uint32_t a_command;
 
+        /*!
+         \brief The commit request sent to the commit hook for the CommitRAMToEEPROM action.
+
+         \see APLoader::composeCommitRequest
+         */
+        std::vector<uint8_t> a_commitRequest;
+
+        /*!
+         \brief The payload streamed to the helper in stage 9.
+         */
+        std::vector<uint8_t> a_payload;
+
+        /*!
+         \brief The helper address of the first byte of a_payload.
+         */
+        uint32_t a_payloadAddress;
+
+        /*!
+         \brief The 32 KB hub RAM contents sent to the helper to boot in stage 10.
+
+         \see APLoader::composeEEPROMImage
+         */
+        std::vector<uint8_t> a_kernelImage;
+
+        /*!
+         \brief The files written to the SD card in stage 9 of ProvisionSD.
+
+         For provisionSDRaw there is a single entry with an empty path, and a_payloadAddress
+         is the starting sector.
+         */
+        std::vector<APLoader::SDFile> a_sdFiles;
+
 
 #pragma mark - [Internal] Miscellaneous Action Variables
 
@@ -852,6 +1297,13 @@ namespace APLoader {
          */
         std::vector<uint8_t> a_buffer;
 
+        /*!
+         \brief Holds the helper frame being sent.
+
+         Separate from a_buffer, which receives the replies.
+         */
+        std::vector<uint8_t> a_helperFrame;
+
         /*!
          \brief A copy of the summary data for the actionDidFinish callback.
          */
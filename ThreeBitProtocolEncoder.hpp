@@ -27,7 +27,7 @@
  reliable communications with the Propeller's booter program, which uses the RCFAST
  clock mode (8 MHz - 20 MHz).
  
- Its output can be transmitted at up to 115200 bps. See ThreeBitProtocolEncoder::MaxBaudrate for details.
+ Its output can be transmitted at up to about 133 kbps. See ThreeBitProtocolEncoder::MaxBaudrate for details.
  */
 
 class ThreeBitProtocolEncoder {
@@ -59,10 +59,10 @@ public:
     size_t encodeBytesAsLongs(const std::vector<uint8_t>& bytes);
 
     /*!
-     \brief The maximum guaranteed safe baudrate for trasmitting data encoded by this class
+     \brief The analyzed upper limit of the baudrate for trasmitting data encoded by this class
      to the Propeller bootloader.
      
-     The limit of 115200 bps was chosen after close analysis of the Propeller's booter program. Two
+     The limit of 133333 bps was determined by close analysis of the Propeller's booter program. Two
      aspects of receiving data were considered: pulse duration and interpulse timing.
      
      __Pulse Duration__
@@ -87,7 +87,8 @@ public:
      The Propeller does work after receiving one encoded bit and before
      being able to receive the next encoded bit. If one bit period is used between bits of the
      same long, and two bit periods are used between bits of different longs, then the
-     maximum safe baudrate is 150 kbps (assuming up to ±10% jitter and an 8 MHz clock).
+     maximum safe baudrate is 150 kbps (assuming up to ±10% jitter and an 8 MHz clock). The
+     prepared handshake data (APLoader::InitBytes) is encoded so that it shares this limit.
      
      The following table gives the minimum number of clocks of high idle between events for
      reliable communications. It is based on a count of instructions from the booter
@@ -95,28 +96,39 @@ public:
      Worst case assumptions are used: being 8 clocks late in detecting the rising edge, and
      hub instructions taking 23 clocks.
      
-     | Interval                                 | Clocks | Requires 2T at 115200 |
-     |------------------------------------------|--------|-----------------------|
-     | between host auth bits                   | 60     |                       |
-     | from host auth to prop auth              | 84     | Y                     |
-     | between prop auth bits                   | 48     |                       |
-     | from prop auth to version                | 79     | Y                     |
-     | between version bits                     | 44     |                       |
-     | from version to command                  | 52     |                       |
-     | from command to length                   | 80     | Y                     |
-     | from length to payload                   | 72     | Y                     |
-     | between bits of a payload long           | 44     |                       |
-     | between bits of different payload longs  | 95     | Y                     |
+     The idle column gives the number of bit periods (T) of high idle actually used by this
+     encoder and by APLoader::InitBytes. The last column is the fastest baudrate at which that
+     idle period still provides the required clocks when it is 10% short (jitter) at 8 MHz.
+
+     | Interval                                 | Clocks | Idle | Max baudrate |
+     |------------------------------------------|--------|------|--------------|
+     | between host auth bits                   | 60     | 2T   | 240000       |
+     | from host auth to prop auth              | 84     | 2T   | 171428       |
+     | between prop auth bits                   | 48     | 1T   | 150000       |
+     | from prop auth to version                | 79     | 2T   | 182278       |
+     | between version bits                     | 44     | 1T   | 163636       |
+     | from version to command                  | 52     | *    | --           |
+     | from command to length                   | 80     | 2T   | 180000       |
+     | from length to payload                   | 72     | 2T   | 200000       |
+     | between bits of a payload long           | 44     | 1T   | 163636       |
+     | between bits of different payload longs  | 95     | 2T   | 151578       |
      
-     At 115200 bps and 8 MHz a nominal bit period is 69.4 clocks. So any interval longer than
-     this requires at least two bit periods of high idle.
+     (*) The loader sends the command only after it has received and checked the version, so
+     this interval is at least a round trip through the serial adapter.
+
+     The host authentication bits use two bit periods of idle because the booter needs 60
+     clocks between them; with one bit period they would limit the baudrate to 120000 bps. The
+     binding interpulse constraint is then the 48 clocks between prop auth bits (150000 bps).
 
      __Conclusion__
 
-     115200 bps was chosen because it is the fastest commonly supported baudrate below these
-     two limits.
+     133333 bps is the lower of the two limits. It includes the ±10% jitter allowance, but no
+     other margin. Users of this encoder should stay some margin below it, and should take into
+     account that serial adapters usually can not produce an arbitrary baudrate exactly.
+
+     \see AsyncPropLoader::MaxBaudrate
      */
-    static const uint32_t MaxBaudrate = 115200;
+    static const uint32_t MaxBaudrate = 133333;
 
 private:
 
@@ -174,8 +186,8 @@ private:
     /*!
      \brief The number of bit periods of high idle between encoded bit pulses of different longs.
      
-     This must be 2+ to reliably support 115200 bps since the Propeller does extra work between
-     receiving longs.
+     This must be 2+ to reliably support baudrates above 75 kbps since the Propeller does extra
+     work between receiving longs (95 clocks, with ±10% jitter).
      */
     const size_t InterLongIdleTime = 2;
 };